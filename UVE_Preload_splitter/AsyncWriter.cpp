@@ -0,0 +1,108 @@
+#include "AsyncWriter.h"
+#include "Portability.h"
+#include <algorithm>
+#include <cstdio>
+
+const size_t AsyncWriter::DEFAULT_MAX_BYTES = size_t(64) << 20;
+
+AsyncWriter::AsyncWriter(int threads, size_t max_bytes) : budget_(max_bytes), finishing_(false), failed_(0), appends_queued_(0), appends_done_(0), failed_bundle_(nullptr) {
+	threads = std::max(1, ThreadsAmount(threads));
+	for (int i = 0; i < threads; ++i) {
+		threads_.emplace_back(&AsyncWriter::Work, this);
+	}
+}
+
+AsyncWriter::~AsyncWriter() {
+	Finish();
+}
+
+void AsyncWriter::Save(const std::string& path, Targa&& image) {
+	WriteJob job{};
+	job.path = path;
+	job.bytes = image.PixelsSize() + Targa::HEADER_SIZE;
+	job.image = std::move(image);
+	Queue(std::move(job));
+}
+
+void AsyncWriter::Append(Bundle& bundle, const std::string& path, Targa&& image, const PreloadFrameData& frame) {
+	WriteJob job{};
+	job.path = path;
+	job.bytes = image.PixelsSize() + Targa::HEADER_SIZE;
+	job.image = std::move(image);
+	job.bundle = &bundle;
+	job.frame = frame;
+	Queue(std::move(job));
+}
+
+void AsyncWriter::Queue(WriteJob&& job) {
+	budget_.Reserve(job.bytes);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (job.bundle) {
+			job.sequence = appends_queued_++;
+		}
+		jobs_.push_back(std::move(job));
+	}
+	cv_.notify_one();
+}
+
+int AsyncWriter::Finish() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		finishing_ = true;
+	}
+	cv_.notify_all();
+	for (std::thread& t : threads_) {
+		t.join();
+	}
+	threads_.clear();
+	return failed_;
+}
+
+void AsyncWriter::Work() {
+	for (;;) {
+		WriteJob job{};
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cv_.wait(lock, [&]() { return finishing_ || !jobs_.empty(); });
+			if (jobs_.empty()) {
+				return;
+			}
+			job = std::move(jobs_.front());
+			jobs_.pop_front();
+		}
+		bool saved = true;
+		if (job.bundle) {
+			// Jobs leave the queue in order, so the one holding the next sequence is always running.
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				cv_.wait(lock, [&]() { return appends_done_ == job.sequence; });
+			}
+			// Once a bundle fails the rest of its frames are dropped, it's reported once.
+			if (failed_bundle_ != job.bundle) {
+				saved = job.bundle->AddFrame(job.image, job.frame);
+			}
+		}
+		else {
+			saved = job.image.Save(job.path);
+		}
+		job.image = Targa{};
+		budget_.Finish(job.bytes, 0);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!saved) {
+				printf_s("An error occurred when trying to read/write %s.\n", job.path.c_str());
+				++failed_;
+				if (job.bundle) {
+					failed_bundle_ = job.bundle;
+				}
+			}
+			if (job.bundle) {
+				++appends_done_;
+			}
+		}
+		if (job.bundle) {
+			cv_.notify_all();
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef AsyncWriter_h_
+#define AsyncWriter_h_
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Targa.h"
+#include "Bundle.h"
+#include "Parallel.h"
+
+/*
+Saves images on writer threads, so whoever makes them doesn't wait for the disk.
+Save() and Append() only wait when the images queued take more than max_bytes.
+Appends to a bundle are written in the order they were queued, whichever thread picks them up.
+Plain threads rather than io_uring: the Linux build would need liburing, which the project doesn't depend on,
+and a frame costs an open/close per file that io_uring doesn't save.
+*/
+class AsyncWriter {
+public:
+	AsyncWriter(int threads, size_t max_bytes);
+	~AsyncWriter();
+	AsyncWriter(const AsyncWriter&) = delete;
+	AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+	void Save(const std::string& path, Targa&& image);
+	//The bundle must outlive Finish().
+	void Append(Bundle& bundle, const std::string& path, Targa&& image, const PreloadFrameData& frame);
+	//Waits for everything queued to be written. Returns the amount of files that failed.
+	int Finish();
+
+	static const size_t DEFAULT_MAX_BYTES;
+
+private:
+	struct WriteJob {
+		std::string path{};
+		Targa image{};
+		size_t bytes{ 0 };
+		Bundle* bundle{ nullptr };
+		PreloadFrameData frame{};
+		unsigned long long sequence{ 0 };
+	};
+	void Queue(WriteJob&& job);
+	void Work();
+
+	std::deque<WriteJob> jobs_;
+	std::vector<std::thread> threads_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	MemoryBudget budget_;
+	bool finishing_;
+	int failed_;
+	unsigned long long appends_queued_;
+	unsigned long long appends_done_;
+	Bundle* failed_bundle_;
+};
+
+#endif // !AsyncWriter_h_
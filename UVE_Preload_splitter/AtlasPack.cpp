@@ -1,15 +1,18 @@
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <climits>
 #include "AtlasPack.h"
 #include "IniPreload.h"
+#include "Profile.h"
 #include "Debug.h"
+#include "Portability.h"
 
 const PixelData DebugColourFrame = { 255, 127, 127, 127 }; // 50% grey frame
 const PixelData DebugColourMiddleAbs = { 255, 255, 0, 0 }; // Red absolute middle
 const PixelData DebugColourOffset = { 255, 0, 0, 255 }; // Blue offset
 
-Atlas::Atlas() : pixel_padding_(0), use_power_of_two_(1), colour_padding_(2) {}
+Atlas::Atlas() : pixel_padding_(0), use_power_of_two_(1), colour_padding_(2), mapped_output_(false) {}
 
 void Atlas::SetPadding(int _padding) {
 	pixel_padding_ = _padding;
@@ -23,22 +26,117 @@ void Atlas::SetColourPadding(int _margin) {
 	colour_padding_ = _margin;
 }
 
-int Atlas::SaveAtlas(const std::string& path, const std::vector<AtlasEntry>& images, int frames_amount, int loop_mode, int preload_version, bool force_greyscale) {
-	if (images.empty()) { return -1; }
-	Targa image{};
-	IniPreload preload{};
+void Atlas::SetMappedOutput(bool mapped) {
+	mapped_output_ = mapped;
+}
 
-	int real_frames_amount = images.size();
-	if (frames_amount == -1) {
-		frames_amount = real_frames_amount;
+int Atlas::SliceEntries(const Targa& source, const IniPreload& preload, std::vector<AtlasEntry>& images) {
+	TargaHeader header = source.GetHeader();
+	size_t first = images.size();
+	images.resize(first + preload.frames.size());
+	for (size_t i = 0; i < preload.frames.size(); ++i) {
+		const PreloadFrameData& frame = preload.frames[i];
+		AtlasEntry& entry = images[first + i];
+		header.w = frame.w;
+		header.h = frame.h;
+		entry.image.SetHeader(header);
+		// Entries are read top to bottom (see SaveAtlas), float preloads count y from the bottom.
+		if (!entry.image.CopyRegion(source, frame.x, frame.y, 0, 0, frame.w, frame.h,
+			preload.format_version == IniPreload::VERSION_FLOAT, false)) {
+			printf_s("Frame %zu (%dx%d at %dx%d) does not fit the %dx%d atlas.\n", i, frame.w, frame.h, frame.x, frame.y, source.w, source.h);
+			images.resize(first);
+			return -1;
+		}
+		entry.rect = { 0, 0, frame.w, frame.h };
+		entry.data_start = { 0, 0 };
+		entry.offset = { frame.xo, frame.yo };
 	}
+	return static_cast<int>(preload.frames.size());
+}
 
-	preload.format_version = preload_version;
-	preload.width = size_.x;
-	preload.height = size_.y;
-	preload.frames_amount = frames_amount;
-	preload.file_format = IniPreload::FILE_FORMAT_TGA;
+void Atlas::TrimEntry(AtlasEntry& atl_entry) {
+	// Calculate frame rect and offset
+	//int left_bound = atl_entry.image.w, // Left empty bound width
+	//	top_bound = atl_entry.image.h; // Top empty bound width
+	Vector2f middle_point_og = { static_cast<float>(atl_entry.image.w - 1) / 2.f, static_cast<float>(atl_entry.image.h - 1) / 2.f };
+
+	DEBUG_PRINTVAL(middle_point_og.x, "%.2f");
+	DEBUG_PRINTVAL(middle_point_og.y, "%.2f");
+	int x_useful_min = INT_MAX; // Index of the first pixel from the left that isn't transparent.
+	int x_useful_max = INT_MIN; // Index of the last pixel from the left that isn't transparent.
+	int y_useful_min = INT_MAX; // Index of the first pixel from the top that isn't transparent.
+	int y_useful_max = INT_MIN; // Index of the last pixel from the top that isn't transparent.
+
+	for (int jy = 0; jy < atl_entry.image.h; ++jy) {
+		bool empty_row = true;
+		for (int jx = 0; jx < atl_entry.image.w; ++jx) {
+			// If pixel has something
+			if (!atl_entry.image.PixelIsTransparent(atl_entry.image.GetPixel(jx, jy, false))) {
+				x_useful_min = std::min(x_useful_min, jx);
+				x_useful_max = std::max(x_useful_max, jx);
+				//left_bound = std::min(left_bound, jx); // Is there any case where this is not = x_useful_min?
+				if (empty_row) { empty_row = false; }
+			}
+		}
+		// Line has something
+		if (!empty_row) {
+			y_useful_min = std::min(y_useful_min, jy);
+			y_useful_max = std::max(y_useful_max, jy);
+			//top_bound = std::min(top_bound, jy);
+		}
+	}
+	//DEBUG_PRINTVAL(t_bound, "%d");
+	//DEBUG_PRINTVAL(l_bound, "%d");
+
+	// Offsets!
+	if (x_useful_min == INT_MAX) { // The frame is completely transparent. Use the first pixel and make it 1x1.
+		atl_entry.rect.w = 1;
+		atl_entry.rect.h = 1;
+		atl_entry.data_start.x = 0;
+		atl_entry.data_start.y = 0;
+		atl_entry.offset.x = 0.f;
+		atl_entry.offset.y = 0.f;
+	}
+	else {
+		atl_entry.rect.w = (x_useful_max - x_useful_min) + 1;
+		atl_entry.rect.h = (y_useful_max - y_useful_min) + 1;
+		atl_entry.data_start.x = x_useful_min;
+		atl_entry.data_start.y = y_useful_min;
+		atl_entry.offset.x = x_useful_min + static_cast<float>(atl_entry.rect.w - 1) / 2.f - middle_point_og.x;
+		atl_entry.offset.y = y_useful_min + static_cast<float>(atl_entry.rect.h - 1) / 2.f - middle_point_og.y;
+	}
+}
 
+size_t Atlas::CropEntry(AtlasEntry& atl_entry, bool greyscale) {
+	TargaHeader header = atl_entry.image.GetHeader();
+	header.w = atl_entry.rect.w;
+	header.h = atl_entry.rect.h;
+	if (greyscale) {
+		header.image_descriptor = 8;
+		header.colour_depth = 8;
+		header.image_type = 3; // Uncompressed greyscale
+	}
+	Targa cropped{};
+	cropped.SetHeader(header);
+	// Same top to bottom order TrimEntry and SaveImage use.
+	cropped.CopyRegion(atl_entry.image, atl_entry.data_start.x, atl_entry.data_start.y, 0, 0,
+		atl_entry.rect.w, atl_entry.rect.h, false, false);
+	atl_entry.image = std::move(cropped);
+	atl_entry.data_start = { 0, 0 };
+	return atl_entry.image.data.size();
+}
+
+int Atlas::SaveAtlas(const std::string& path, const std::vector<AtlasEntry>& images, int frames_amount, int loop_mode, int preload_version, bool force_greyscale) {
+	if (images.empty()) { return -1; }
+	if (SaveImage(path, images, preload_version, force_greyscale) == -1) { return -1; }
+	return SavePreload(path + PreloadExtension(preload_version), images, 0, images.size(), frames_amount, loop_mode, preload_version);
+}
+
+std::string Atlas::PreloadExtension(int preload_version) {
+	return (preload_version == IniPreload::VERSION_INI) ? ".ini" : ".ini.preload";
+}
+
+TargaHeader Atlas::ImageHeader(const std::vector<AtlasEntry>& images, bool force_greyscale) const {
 	TargaHeader tga_header = images[0].image.GetHeader();
 	tga_header.w = size_.x;
 	tga_header.h = size_.y;
@@ -47,54 +145,101 @@ int Atlas::SaveAtlas(const std::string& path, const std::vector<AtlasEntry>& ima
 		tga_header.colour_depth = 8;
 		tga_header.image_type = 3; // Uncompressed greyscale
 	}
-	image.SetHeader(tga_header);
+	return tga_header;
+}
+
+int Atlas::SaveImage(const std::string& path, const std::vector<AtlasEntry>& images, int preload_version, bool force_greyscale) {
+	if (images.empty()) { return -1; }
+	PixelScope memory(PIXCAT_ATLAS);
+	Targa image{};
+	TargaHeader tga_header = ImageHeader(images, force_greyscale);
+	bool mapped = mapped_output_ && image.Map(path, tga_header);
+	if (!mapped) {
+		if (mapped_output_) {
+			printf_s("Could not map %s to memory, the atlas is built in memory instead.\n", path.c_str());
+		}
+		image.SetHeader(tga_header);
+	}
+	DrawImage(image, images, preload_version);
+
+	printf_s("Saving the atlas to %s\n", path.c_str());
+	if (mapped) {
+		if (!image.Unmap()) { return -1; }
+	}
+	else if (!image.Save(path)) { return -1; }
+	return 0;
+}
+
+int Atlas::MakeImage(Targa& image, const std::vector<AtlasEntry>& images, int preload_version, bool force_greyscale) {
+	if (images.empty()) { return -1; }
+	PixelScope memory(PIXCAT_ATLAS);
+	image = Targa{};
+	image.SetHeader(ImageHeader(images, force_greyscale));
+	DrawImage(image, images, preload_version);
+	return 0;
+}
+
+void Atlas::DrawImage(Targa& image, const std::vector<AtlasEntry>& images, int preload_version) {
+	// Float preloads count y from the bottom, so the whole atlas is upside down for them.
+	bool flipped = (preload_version == IniPreload::VERSION_FLOAT);
 
 	DEBUG_PRINTVAL(size_.x, "%i");
 	DEBUG_PRINTVAL(size_.y, "%i");
 
-	for (size_t i = 0; i < real_frames_amount; ++i) {
+	ProfileScope profile(PROFSTAGE_BLIT);
+	for (size_t i = 0; i < images.size(); ++i) {
+		Profile::Add(PROFCOUNT_PIXELS_BLITTED, static_cast<long long>(images[i].rect.w) * images[i].rect.h);
 		DEBUG_PRINTVAL(i, "%i [blitting frame]");
 		DEBUG_PRINTVAL(images[i].rect.x, "%i");
 		DEBUG_PRINTVAL(images[i].rect.y, "%i");
 		DEBUG_PRINTVAL(images[i].rect.w, "%i");
 		DEBUG_PRINTVAL(images[i].rect.h, "%i");
 
-		//Make fun of colour bleeding
-		if (image.GetHeader().colour_depth == 32) {
-			for (int i2 = colour_padding_; i2 > 0; --i2) {
-				//Up
-				image.BlitRegionTransparent(
-					images[i].image.GetRegion(images[i].data_start.x, images[i].data_start.y, images[i].rect.w, images[i].rect.h, false),
-					images[i].rect.x, images[i].rect.y - i2, images[i].rect.w, images[i].rect.h,
-					preload.IsFlipped(), 0
-				);
-				//Down
-				image.BlitRegionTransparent(
-					images[i].image.GetRegion(images[i].data_start.x, images[i].data_start.y, images[i].rect.w, images[i].rect.h, false),
-					images[i].rect.x, images[i].rect.y + i2, images[i].rect.w, images[i].rect.h,
-					preload.IsFlipped(), 0
-				);
-				//Left
-				image.BlitRegionTransparent(
-					images[i].image.GetRegion(images[i].data_start.x, images[i].data_start.y, images[i].rect.w, images[i].rect.h, false),
-					images[i].rect.x - i2, images[i].rect.y, images[i].rect.w, images[i].rect.h,
-					preload.IsFlipped(), 0
-				);
-				//Right
-				image.BlitRegionTransparent(
-					images[i].image.GetRegion(images[i].data_start.x, images[i].data_start.y, images[i].rect.w, images[i].rect.h, false),
-					images[i].rect.x + i2, images[i].rect.y, images[i].rect.w, images[i].rect.h,
-					preload.IsFlipped(), 0
-				);
+		// 8 bit entries go to an 8 bit atlas a row at a time, colour padding isn't drawn for them anyway.
+		bool copied = (image.colour_depth == 8) && image.CopyRegionTransparent(images[i].image,
+			images[i].data_start.x, images[i].data_start.y, images[i].rect.x, images[i].rect.y, images[i].rect.w, images[i].rect.h,
+			false, flipped, debug_show_transparency);
+		if (!copied) {
+			// Same pixels for every padding pass and the image itself
+			PixelRegion region = images[i].image.GetRegion(images[i].data_start.x, images[i].data_start.y, images[i].rect.w, images[i].rect.h, false);
+
+			//Make fun of colour bleeding
+			if (image.GetHeader().colour_depth == 32) {
+				for (int i2 = colour_padding_; i2 > 0; --i2) {
+					//Up
+					image.BlitRegionTransparent(
+						region,
+						images[i].rect.x, images[i].rect.y - i2, images[i].rect.w, images[i].rect.h,
+						flipped, 0
+					);
+					//Down
+					image.BlitRegionTransparent(
+						region,
+						images[i].rect.x, images[i].rect.y + i2, images[i].rect.w, images[i].rect.h,
+						flipped, 0
+					);
+					//Left
+					image.BlitRegionTransparent(
+						region,
+						images[i].rect.x - i2, images[i].rect.y, images[i].rect.w, images[i].rect.h,
+						flipped, 0
+					);
+					//Right
+					image.BlitRegionTransparent(
+						region,
+						images[i].rect.x + i2, images[i].rect.y, images[i].rect.w, images[i].rect.h,
+						flipped, 0
+					);
+				}
 			}
-		}
 
-		//Draw an actual image
-		image.BlitRegionTransparent(
-			images[i].image.GetRegion(images[i].data_start.x, images[i].data_start.y, images[i].rect.w, images[i].rect.h, false),
-			images[i].rect.x, images[i].rect.y, images[i].rect.w, images[i].rect.h,
-			preload.IsFlipped(), 255U, debug_show_transparency
-		);
+			//Draw an actual image
+			image.BlitRegionTransparent(
+				region,
+				images[i].rect.x, images[i].rect.y, images[i].rect.w, images[i].rect.h,
+				flipped, 255U, debug_show_transparency
+			);
+		}
 
 		int middle_x = static_cast<int>(std::ceil(static_cast<float>(images[i].rect.w - 1) / 2.f));
 		int middle_y = static_cast<int>(std::ceil(static_cast<float>(images[i].rect.h - 1) / 2.f));
@@ -104,12 +249,12 @@ int Atlas::SaveAtlas(const std::string& path, const std::vector<AtlasEntry>& ima
 			image.SetPixel(
 				images[i].rect.x + middle_x - images[i].offset.x,
 				images[i].rect.y + middle_y - images[i].offset.y,
-				DebugColourMiddleAbs, preload.IsFlipped());
+				DebugColourMiddleAbs, flipped);
 			// Middle point of the frame.
 			image.SetPixel(
 				images[i].rect.x + middle_x,
 				images[i].rect.y + middle_y,
-				DebugColourOffset, preload.IsFlipped());
+				DebugColourOffset, flipped);
 		}
 		if (debug_show_frame) {
 			// Frame top and bottom
@@ -118,12 +263,12 @@ int Atlas::SaveAtlas(const std::string& path, const std::vector<AtlasEntry>& ima
 					images[i].rect.x + x,
 					images[i].rect.y,
 					(x != middle_x) ? DebugColourFrame : PixelData{ DebugColourFrame.a, uint8_t(DebugColourFrame.r * 0.7), uint8_t(DebugColourFrame.g * 0.7), uint8_t(DebugColourFrame.b * 0.7) },
-					preload.IsFlipped());
+					flipped);
 				image.SetPixel(
 					images[i].rect.x + x,
 					images[i].rect.y + images[i].rect.h - 1,
 					(x != middle_x) ? DebugColourFrame : PixelData{ DebugColourFrame.a, uint8_t(DebugColourFrame.r * 0.7), uint8_t(DebugColourFrame.g * 0.7), uint8_t(DebugColourFrame.b * 0.7) },
-					preload.IsFlipped());
+					flipped);
 			}
 			// Frame sides
 			for (int y = 0; y < images[i].rect.h; ++y) {
@@ -131,12 +276,12 @@ int Atlas::SaveAtlas(const std::string& path, const std::vector<AtlasEntry>& ima
 					images[i].rect.x,
 					images[i].rect.y + y,
 					(y != middle_y) ? DebugColourFrame : PixelData{ DebugColourFrame.a, uint8_t(DebugColourFrame.r * 0.7), uint8_t(DebugColourFrame.g * 0.7), uint8_t(DebugColourFrame.b * 0.7) },
-					preload.IsFlipped());
+					flipped);
 				image.SetPixel(
 					images[i].rect.x + images[i].rect.w - 1,
 					images[i].rect.y + y,
 					(y != middle_y) ? DebugColourFrame : PixelData{ DebugColourFrame.a, uint8_t(DebugColourFrame.r * 0.7), uint8_t(DebugColourFrame.g * 0.7), uint8_t(DebugColourFrame.b * 0.7) },
-					preload.IsFlipped());
+					flipped);
 			}
 			if (true) { // NOTE: Still thinking about whether this should be optional. -- mish 14.06.2026
 				// Colour padding frame top and bottom
@@ -150,7 +295,7 @@ int Atlas::SaveAtlas(const std::string& path, const std::vector<AtlasEntry>& ima
 							uint8_t(DebugColourFrame.g),
 							uint8_t(DebugColourFrame.b * 1.25)
 						}, // May overflow if the colour is different but who cares? Nobody seems to use this app anyway.
-						preload.IsFlipped());
+						flipped);
 					image.SetPixel(
 						images[i].rect.x + x,
 						images[i].rect.y + images[i].rect.h - 1 + colour_padding_,
@@ -160,7 +305,7 @@ int Atlas::SaveAtlas(const std::string& path, const std::vector<AtlasEntry>& ima
 							uint8_t(DebugColourFrame.g),
 							uint8_t(DebugColourFrame.b * 1.25)
 						},
-						preload.IsFlipped());
+						flipped);
 				}
 				// Colour padding frame sides
 				for (int y = 0 - colour_padding_; y < images[i].rect.h + colour_padding_; ++y) {
@@ -173,7 +318,7 @@ int Atlas::SaveAtlas(const std::string& path, const std::vector<AtlasEntry>& ima
 							uint8_t(DebugColourFrame.g),
 							uint8_t(DebugColourFrame.b * 1.25)
 						},
-						preload.IsFlipped());
+						flipped);
 					image.SetPixel(
 						images[i].rect.x + images[i].rect.w - 1 + colour_padding_,
 						images[i].rect.y + y,
@@ -183,11 +328,38 @@ int Atlas::SaveAtlas(const std::string& path, const std::vector<AtlasEntry>& ima
 							uint8_t(DebugColourFrame.g),
 							uint8_t(DebugColourFrame.b * 1.25)
 						},
-						preload.IsFlipped());
+						flipped);
 				}
 			}
 		}
+	}
+
+}
+
+int Atlas::SavePreload(const std::string& path, const std::vector<AtlasEntry>& images, size_t first, size_t count, int frames_amount, int loop_mode, int preload_version) {
+	ProfileScope profile(PROFSTAGE_PRELOAD);
+	IniPreload preload{};
+	if (MakePreload(preload, images, first, count, frames_amount, loop_mode, preload_version) == -1) { return -1; }
+	if (!preload.Save(path)) { return -1; }
+	return 0;
+}
+
+int Atlas::MakePreload(IniPreload& preload, const std::vector<AtlasEntry>& images, size_t first, size_t count, int frames_amount, int loop_mode, int preload_version) const {
+	if (count == 0 || first + count > images.size()) { return -1; }
+	preload = IniPreload{};
+
+	int real_frames_amount = count;
+	if (frames_amount <= 0) {
+		frames_amount = real_frames_amount;
+	}
 
+	preload.format_version = preload_version;
+	preload.width = size_.x;
+	preload.height = size_.y;
+	preload.frames_amount = frames_amount;
+	preload.file_format = IniPreload::FILE_FORMAT_TGA;
+
+	for (size_t i = first; i < first + count; ++i) {
 		PreloadFrameData frame{ 0 };
 		frame.x = images[i].rect.x;
 		frame.y = images[i].rect.y;
@@ -225,17 +397,19 @@ int Atlas::SaveAtlas(const std::string& path, const std::vector<AtlasEntry>& ima
 
 		preload.AddEntry(preload.GetEntry(index));
 	}
-	printf_s("Saving the atlas to %s\n", path.c_str());
-	image.Save(path);
-	preload.Save(path + ((preload.format_version == IniPreload::VERSION_INI) ? ".ini" : ".ini.preload"));
 	return 0;
 }
 
 int Atlas::CreateAtlas(std::vector<AtlasEntry>& images) {
 	images_area = 0;
-	GetSizes(images, sizes_);
-	sorted_ids_ = GetSortedIndices(images);
+	{
+		ProfileScope profile(PROFSTAGE_SIZES);
+		GetSizes(images, sizes_);
+		sorted_ids_ = GetSortedIndices(images);
+	}
 
+	ProfileScope profile(PROFSTAGE_PACK);
+	Profile::AddAttempt(size_.x, size_.y);
 	while (!PackAtlas(images, size_, sorted_ids_)) {
 		if (!use_power_of_two_) {
 			++size_.x;
@@ -252,6 +426,7 @@ int Atlas::CreateAtlas(std::vector<AtlasEntry>& images) {
 		std::pop_heap(sizes_.begin(), sizes_.end(), [](Vector2 a, Vector2 b) { return a.x * a.y > b.x * b.y; });
 		size_ = sizes_.back();
 		sizes_.pop_back();
+		Profile::AddAttempt(size_.x, size_.y);
 #ifdef DEBUG_ENABLE
 		for (int i = 0; i < sizes_.size(); ++i) {
 			printf_s("sizes[%i] = {%i, %i} (CreateAtlas)\n", 
@@ -381,7 +556,7 @@ std::vector<int> Atlas::GetSortedIndices(const std::vector<AtlasEntry>& images)
 	*/
 	std::iota(sorted_ids.begin(), sorted_ids.end(), 0);
 	std::sort(sorted_ids.begin(), sorted_ids.end(),
-		[&images](int i, int j) { return images[i].rect.h > images[j].image.h; } // NOTE: Revise why we sort by height specifically -- mish 11.06.26
+		[&images](int i, int j) { return images[i].rect.h > images[j].rect.h; } // NOTE: Revise why we sort by height specifically -- mish 11.06.26
 	);
 	return sorted_ids;
 }
@@ -405,6 +580,8 @@ bool Atlas::PackAtlas(std::vector<AtlasEntry>& images, Vector2 size,
 
 	for (int image = 0; image < images.size(); ++image) {
 		if (free_rects_.empty()) { return false; }
+		Profile::Add(PROFCOUNT_FREE_RECTS_SCANNED, free_rects_.size());
+		Profile::Max(PROFCOUNT_FREE_RECTS_PEAK, free_rects_.size());
 
 		int current_index = sorted_ids[image];
 		DEBUG_PRINTVAL(current_index, "%i");
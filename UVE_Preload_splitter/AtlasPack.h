@@ -7,6 +7,7 @@ https://github.com/Nickswoboda/atlas-packer was used as a reference, though high
 
 #include <vector>
 #include "Targa.h"
+#include "IniPreload.h"
 #include <string>
 
 #define MAX_ATLAS_SIZE 8128// 8192
@@ -54,7 +55,22 @@ public:
 	void SetPadding(int _padding);
 	void SetPowerOfTwo(bool pot);
 	int SaveAtlas(const std::string& path, const std::vector<AtlasEntry>& images, int frames_amount, int loop_mode, int preload_version, bool force_greyscale = false);
+	//SaveAtlas() in two steps, so several preloads can share one image.
+	int SaveImage(const std::string& path, const std::vector<AtlasEntry>& images, int preload_version, bool force_greyscale = false);
+	int SavePreload(const std::string& path, const std::vector<AtlasEntry>& images, size_t first, size_t count, int frames_amount, int loop_mode, int preload_version);
+	//SaveImage() and SavePreload() into memory instead of files.
+	int MakeImage(Targa& image, const std::vector<AtlasEntry>& images, int preload_version, bool force_greyscale = false);
+	int MakePreload(IniPreload& preload, const std::vector<AtlasEntry>& images, size_t first, size_t count, int frames_amount, int loop_mode, int preload_version) const;
+	static std::string PreloadExtension(int preload_version);
 	void SetColourPadding(int _margin);
+	//SaveImage() draws straight into a file mapped to memory instead of building the atlas first.
+	void SetMappedOutput(bool mapped);
+	//Finds the useful (non transparent) rect of the image and the offset of its middle.
+	static void TrimEntry(AtlasEntry& atl_entry);
+	//Drops the pixels outside of a trimmed entry's rect, and converts it to 8 bit (red channel) if greyscale. Returns the bytes left.
+	static size_t CropEntry(AtlasEntry& atl_entry, bool greyscale = false);
+	//Cuts every preload frame out of an existing atlas into its own entry. Already trimmed, no scanning needed.
+	static int SliceEntries(const Targa& source, const IniPreload& preload, std::vector<AtlasEntry>& images);
 
 	Vector2 size_{ 1,1 };
 	std::vector<Vector2> sizes_{};
@@ -68,12 +84,16 @@ public:
 	bool debug_middle_point = false;
 
 private:
+	TargaHeader ImageHeader(const std::vector<AtlasEntry>& images, bool force_greyscale) const;
+	//Draws the entries (and their colour padding) into image, which is already size_.
+	void DrawImage(Targa& image, const std::vector<AtlasEntry>& images, int preload_version);
 	bool IntersectsRect(const Rect& new_rect, const Rect& free_rect);
 	void PushSplitRects(const Rect& new_rect, const Rect free_rect);
 	bool EnclosedInRect(const Rect& a, const Rect& b);
 
 	std::vector<Rect> free_rects_{};
 	bool use_power_of_two_;
+	bool mapped_output_;
 };
 
 #endif // !AtlasPack_h_
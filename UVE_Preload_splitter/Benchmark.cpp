@@ -0,0 +1,256 @@
+#include "Benchmark.h"
+#include "Targa.h"
+#include "AtlasPack.h"
+#include "IniPreload.h"
+#include "Portability.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <vector>
+
+static const double BENCH_MIN_SECONDS = 0.25;
+static const int BENCH_IMAGE_SIZE = 1024;
+static const int BENCH_REGION_SIZE = 128;
+static const int BENCH_PACK_FRAMES = 500;
+static const int BENCH_PRELOAD_FRAMES = 20000;
+static volatile unsigned bench_sink = 0; // Keeps the compiler from dropping the work
+
+// Seconds one run of body takes, on average. The first run only warms up.
+static double TimeRuns(const std::function<void()>& body) {
+	body();
+	int runs = 0;
+	double elapsed = 0;
+	auto start = std::chrono::steady_clock::now();
+	do {
+		body();
+		++runs;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < BENCH_MIN_SECONDS);
+	return elapsed / runs;
+}
+
+static void ReportPixels(const char* name, int depth, double seconds, size_t pixels) {
+	printf_s("%-24s %2d bit %10.3f ns/px %10.1f MB/s\n", name, depth,
+		seconds * 1e9 / pixels, pixels * (depth >> 3) / seconds / (1 << 20));
+}
+
+static void ReportFrames(const char* name, const char* set, double seconds, size_t frames, size_t bytes) {
+	printf_s("%-24s %-10s %10.3f ms %12.0f frames/s", name, set, seconds * 1e3, frames / seconds);
+	if (bytes) {
+		printf_s(" %10.1f MB/s", bytes / seconds / (1 << 20));
+	}
+	printf_s("\n");
+}
+
+// Random pixels, about half of them transparent for BlitRegionTransparent().
+static Targa MakeImage(int depth, std::mt19937& random) {
+	TargaHeader header{};
+	header.w = BENCH_IMAGE_SIZE;
+	header.h = BENCH_IMAGE_SIZE;
+	header.colour_depth = static_cast<unsigned char>(depth);
+	header.image_type = (depth == 8) ? 3 : 2;
+	header.image_descriptor = (depth == 32) ? 8 : 0;
+	Targa image{};
+	image.SetHeader(header);
+	size_t bpp = depth >> 3;
+	for (size_t i = 0; i < image.data.size(); i += bpp) {
+		bool transparent = random() & 1;
+		for (size_t c = 0; c < bpp; ++c) {
+			image.data[i + c] = transparent ? 0 : static_cast<unsigned char>(random() | 1);
+		}
+	}
+	return image;
+}
+
+static void RunPixels() {
+	std::mt19937 random(42);
+	const size_t pixels = static_cast<size_t>(BENCH_IMAGE_SIZE) * BENCH_IMAGE_SIZE;
+	for (int depth : { 8, 24, 32 }) {
+		Targa image = MakeImage(depth, random);
+		Targa target = image;
+
+		double seconds = TimeRuns([&]() {
+			unsigned sum = 0;
+			for (int y = 0; y < BENCH_IMAGE_SIZE; ++y) {
+				for (int x = 0; x < BENCH_IMAGE_SIZE; ++x) {
+					PixelData px = image.GetPixel(x, y);
+					sum += px.a + px.r;
+				}
+			}
+			bench_sink = sum;
+		});
+		ReportPixels("Targa::GetPixel", depth, seconds, pixels);
+
+		seconds = TimeRuns([&]() {
+			PixelData px{ 255, 10, 20, 30 };
+			for (int y = 0; y < BENCH_IMAGE_SIZE; ++y) {
+				for (int x = 0; x < BENCH_IMAGE_SIZE; ++x) {
+					px.r = static_cast<unsigned char>(x);
+					target.SetPixel(x, y, px);
+				}
+			}
+		});
+		ReportPixels("Targa::SetPixel", depth, seconds, pixels);
+
+		seconds = TimeRuns([&]() {
+			for (int y = 0; y < BENCH_IMAGE_SIZE; y += BENCH_REGION_SIZE) {
+				for (int x = 0; x < BENCH_IMAGE_SIZE; x += BENCH_REGION_SIZE) {
+					PixelRegion region = image.GetRegion(x, y, BENCH_REGION_SIZE, BENCH_REGION_SIZE);
+					bench_sink = region[0].r;
+				}
+			}
+		});
+		ReportPixels("Targa::GetRegion", depth, seconds, pixels);
+
+		std::vector<PixelRegion> regions{};
+		for (int y = 0; y < BENCH_IMAGE_SIZE; y += BENCH_REGION_SIZE) {
+			for (int x = 0; x < BENCH_IMAGE_SIZE; x += BENCH_REGION_SIZE) {
+				regions.push_back(image.GetRegion(x, y, BENCH_REGION_SIZE, BENCH_REGION_SIZE));
+			}
+		}
+		seconds = TimeRuns([&]() {
+			size_t i = 0;
+			for (int y = 0; y < BENCH_IMAGE_SIZE; y += BENCH_REGION_SIZE) {
+				for (int x = 0; x < BENCH_IMAGE_SIZE; x += BENCH_REGION_SIZE) {
+					target.BlitRegionTransparent(regions[i++], x, y, BENCH_REGION_SIZE, BENCH_REGION_SIZE);
+				}
+			}
+		});
+		ReportPixels("Targa::BlitRegionTransp.", depth, seconds, pixels);
+	}
+}
+
+// Frames with only their trimmed rects set, which is all the packer looks at.
+static std::vector<AtlasEntry> MakeFrames(const char* set, std::mt19937& random) {
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	std::vector<AtlasEntry> frames(BENCH_PACK_FRAMES);
+	for (AtlasEntry& frame : frames) {
+		frame.image.colour_depth = 32;
+		double u = unit(random), v = unit(random);
+		if (!strcmp(set, "uniform")) {
+			frame.rect.w = 48 + static_cast<int>(16 * u);
+			frame.rect.h = 48 + static_cast<int>(16 * v);
+		}
+		else if (!strcmp(set, "skewed")) {
+			frame.rect.w = 8 + static_cast<int>(248 * u * u);
+			frame.rect.h = 8 + static_cast<int>(248 * v * v);
+		}
+		else { // long-tail: mostly small, one in twenty large
+			bool large = unit(random) < 0.05;
+			frame.rect.w = large ? 128 + static_cast<int>(384 * u) : 8 + static_cast<int>(24 * u);
+			frame.rect.h = large ? 128 + static_cast<int>(384 * v) : 8 + static_cast<int>(24 * v);
+		}
+	}
+	return frames;
+}
+
+static void RunPack() {
+	std::mt19937 random(42);
+	for (const char* set : { "uniform", "skewed", "long-tail" }) {
+		std::vector<AtlasEntry> frames = MakeFrames(set, random);
+
+		std::vector<Vector2> sizes{};
+		double seconds = TimeRuns([&]() {
+			Atlas atlas;
+			atlas.GetSizes(frames, sizes);
+		});
+		ReportFrames("Atlas::GetSizes", set, seconds, frames.size(), 0);
+
+		Atlas packed;
+		if (packed.CreateAtlas(frames) == -1) {
+			printf_s("Atlas::CreateAtlas       %-10s could not pack.\n", set);
+			continue;
+		}
+		Vector2 size = packed.size_;
+		std::vector<int> sorted_ids = packed.GetSortedIndices(frames);
+		seconds = TimeRuns([&]() {
+			bench_sink = packed.PackAtlas(frames, size, sorted_ids);
+		});
+		ReportFrames("Atlas::PackAtlas", set, seconds, frames.size(), 0);
+
+		seconds = TimeRuns([&]() {
+			Atlas atlas;
+			bench_sink = atlas.CreateAtlas(frames);
+		});
+		ReportFrames("Atlas::CreateAtlas", set, seconds, frames.size(), 0);
+		printf_s("%-24s %-10s %dx%d\n", "  atlas size", set, size.x, size.y);
+	}
+}
+
+static int RunPreload() {
+	std::mt19937 random(42);
+	std::uniform_int_distribution<int> coord(0, 4096), side(1, 256);
+	std::uniform_real_distribution<float> offset(-128.f, 128.f);
+	std::error_code error{};
+	std::filesystem::path dir = std::filesystem::temp_directory_path(error);
+	if (error) {
+		dir = ".";
+	}
+	int result = 1;
+	for (unsigned int version : { IniPreload::VERSION_INT, IniPreload::VERSION_FLOAT, IniPreload::VERSION_INI }) {
+		IniPreload preload{};
+		preload.SetVersion(version);
+		preload.width = 4096;
+		preload.height = 4096;
+		preload.file_format = IniPreload::FILE_FORMAT_TGA;
+		for (int i = 0; i < BENCH_PRELOAD_FRAMES; ++i) {
+			preload.AddEntry({ coord(random), coord(random), side(random), side(random), offset(random), offset(random) });
+		}
+		preload.frames_amount = BENCH_PRELOAD_FRAMES;
+		const char* name = (version == IniPreload::VERSION_INT) ? "int" : (version == IniPreload::VERSION_FLOAT) ? "float" : "ini";
+		std::string path = (dir / (std::string("uveps_benchmark_") + name + Atlas::PreloadExtension(version))).string();
+
+		double seconds = TimeRuns([&]() {
+			bench_sink = preload.Save(path);
+		});
+		size_t bytes = static_cast<size_t>(std::filesystem::file_size(path, error));
+		if (error || !bench_sink) {
+			printf_s("Could not write %s.\n", path.c_str());
+			result = 0;
+			continue;
+		}
+		ReportFrames("IniPreload::Save", name, seconds, BENCH_PRELOAD_FRAMES, bytes);
+
+		seconds = TimeRuns([&]() {
+			IniPreload opened{};
+			bench_sink = opened.Open(path);
+		});
+		ReportFrames("IniPreload::Open", name, seconds, BENCH_PRELOAD_FRAMES, bytes);
+		std::filesystem::remove(path, error);
+	}
+	return result;
+}
+
+int Benchmark::GroupFromName(const std::string& name) {
+	if (name == "pixels") { return BENCHGROUP_PIXELS; }
+	if (name == "pack") { return BENCHGROUP_PACK; }
+	if (name == "preload") { return BENCHGROUP_PRELOAD; }
+	if (name == "all") { return BENCHGROUP_ALL; }
+	return 0;
+}
+
+int Benchmark::Run(const std::string& group) {
+	int groups = GroupFromName(group);
+	if (!groups) {
+		printf_s("Unknown benchmark group %s.\n", group.c_str());
+		return 0;
+	}
+	int result = 1;
+	if (groups & BENCHGROUP_PIXELS) {
+		printf_s("\nPixels (%dx%d image, %dx%d regions)\n", BENCH_IMAGE_SIZE, BENCH_IMAGE_SIZE, BENCH_REGION_SIZE, BENCH_REGION_SIZE);
+		RunPixels();
+	}
+	if (groups & BENCHGROUP_PACK) {
+		printf_s("\nPacking (%d frames)\n", BENCH_PACK_FRAMES);
+		RunPack();
+	}
+	if (groups & BENCHGROUP_PRELOAD) {
+		printf_s("\nPreloads (%d frames)\n", BENCH_PRELOAD_FRAMES);
+		result = RunPreload();
+	}
+	return result;
+}
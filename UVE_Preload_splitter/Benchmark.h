@@ -0,0 +1,24 @@
+#ifndef Benchmark_h_
+#define Benchmark_h_
+
+#include <string>
+
+enum BenchmarkGroups {
+	BENCHGROUP_PIXELS = 1, // Targa pixel access and blits
+	BENCHGROUP_PACK = 2, // Atlas sizes and packing
+	BENCHGROUP_PRELOAD = 4, // IniPreload reading and writing
+	BENCHGROUP_ALL = 7
+};
+
+/*
+--benchmark: times the pixel, packer and preload hot paths on generated data, nothing has to be given to it.
+Every case runs until it took long enough to be measured, the average run is reported.
+*/
+class Benchmark {
+public:
+	//group is pixels, pack, preload or all. Preload files are written to the temporary directory. Returns 1 if all of it ran.
+	static int Run(const std::string& group);
+	static int GroupFromName(const std::string& name);
+};
+
+#endif // !Benchmark_h_
@@ -0,0 +1,147 @@
+#include "Bundle.h"
+#include "OutputCache.h"
+#include <filesystem>
+
+const char* Bundle::EXTENSION = ".tgab";
+
+Bundle::Bundle() : reserved_frames_(0), writing_(false) {}
+
+Bundle::~Bundle() {
+	if (writing_) {
+		Close();
+	}
+}
+
+bool Bundle::IsBundlePath(const std::string& path) {
+	std::string ext = EXTENSION;
+	return path.size() > ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+int Bundle::Create(const std::string& path, int frames_amount) {
+	OutputCache::Unshare(path);
+	file_.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+	if (!file_) {
+		return 0;
+	}
+	frames.clear();
+	reserved_frames_ = frames_amount;
+	writing_ = true;
+
+	// The index is filled in on Close() when all offsets are known.
+	std::vector<char> placeholder(HEADER_SIZE + INDEX_ENTRY_SIZE * frames_amount, 0);
+	file_.write(placeholder.data(), placeholder.size());
+	return file_ ? 1 : 0;
+}
+
+int Bundle::AddFrame(const Targa& image, const PreloadFrameData& frame) {
+	if (!writing_ || static_cast<int>(frames.size()) >= reserved_frames_) {
+		return 0;
+	}
+	BundleFrame entry{};
+	file_.seekp(0, std::ios::end);
+	entry.offset = static_cast<unsigned long long>(file_.tellp());
+	image.Save(file_);
+	entry.size = static_cast<unsigned int>(static_cast<unsigned long long>(file_.tellp()) - entry.offset);
+	entry.frame = frame;
+	frames.push_back(entry);
+	return file_ ? 1 : 0;
+}
+
+int Bundle::Close() {
+	if (!writing_) {
+		file_.close();
+		return 1;
+	}
+	writing_ = false;
+
+	unsigned int magic = MAGIC, version = VERSION, frames_amount = static_cast<unsigned int>(frames.size());
+	file_.seekp(0);
+	file_.write(reinterpret_cast<char*>(&magic), 4);
+	file_.write(reinterpret_cast<char*>(&version), 4);
+	file_.write(reinterpret_cast<char*>(&frames_amount), 4);
+	for (BundleFrame& entry : frames) {
+		file_.write(reinterpret_cast<char*>(&entry.offset), 8);
+		file_.write(reinterpret_cast<char*>(&entry.size), 4);
+		file_.write(reinterpret_cast<char*>(&entry.frame.x), 4);
+		file_.write(reinterpret_cast<char*>(&entry.frame.y), 4);
+		file_.write(reinterpret_cast<char*>(&entry.frame.w), 4);
+		file_.write(reinterpret_cast<char*>(&entry.frame.h), 4);
+		file_.write(reinterpret_cast<char*>(&entry.frame.xo), 4);
+		file_.write(reinterpret_cast<char*>(&entry.frame.yo), 4);
+	}
+	bool ok = static_cast<bool>(file_);
+	file_.close();
+	return ok ? 1 : 0;
+}
+
+int Bundle::Open(const std::string& path) {
+	file_.open(path, std::ios::binary | std::ios::in);
+	if (!file_) {
+		return 0;
+	}
+	writing_ = false;
+	unsigned int magic = 0, version = 0, frames_amount = 0;
+	file_.read(reinterpret_cast<char*>(&magic), 4);
+	file_.read(reinterpret_cast<char*>(&version), 4);
+	file_.read(reinterpret_cast<char*>(&frames_amount), 4);
+	if (!file_ || magic != MAGIC || version != VERSION) {
+		file_.close();
+		return 0;
+	}
+	// The amount comes from the file, the index has to fit in it before anything is reserved.
+	std::error_code error{};
+	unsigned long long file_size = static_cast<unsigned long long>(std::filesystem::file_size(path, error));
+	if (error || HEADER_SIZE + static_cast<unsigned long long>(INDEX_ENTRY_SIZE) * frames_amount > file_size) {
+		file_.close();
+		return 0;
+	}
+
+	frames.clear();
+	frames.reserve(frames_amount);
+	for (unsigned int i = 0; i < frames_amount && file_; ++i) {
+		BundleFrame entry{};
+		file_.read(reinterpret_cast<char*>(&entry.offset), 8);
+		file_.read(reinterpret_cast<char*>(&entry.size), 4);
+		file_.read(reinterpret_cast<char*>(&entry.frame.x), 4);
+		file_.read(reinterpret_cast<char*>(&entry.frame.y), 4);
+		file_.read(reinterpret_cast<char*>(&entry.frame.w), 4);
+		file_.read(reinterpret_cast<char*>(&entry.frame.h), 4);
+		file_.read(reinterpret_cast<char*>(&entry.frame.xo), 4);
+		file_.read(reinterpret_cast<char*>(&entry.frame.yo), 4);
+		if (entry.offset > file_size || entry.size > file_size - entry.offset) {
+			file_.close();
+			frames.clear();
+			return 0;
+		}
+		frames.push_back(entry);
+	}
+	if (!file_) {
+		file_.close();
+		return 0;
+	}
+	return 1;
+}
+
+int Bundle::GetFrame(int index, Targa& image) {
+	if (index < 0 || index >= static_cast<int>(frames.size()) || !file_.is_open()) {
+		return 0;
+	}
+	const BundleFrame& entry = frames[index];
+	file_.clear();
+	file_.seekg(static_cast<std::streamoff>(entry.offset));
+	// The embedded header comes from the file too, its pixels have to fit in the entry before anything is allocated.
+	unsigned char header[Targa::HEADER_SIZE] = { 0 };
+	if (entry.size < Targa::HEADER_SIZE || !file_.read(reinterpret_cast<char*>(header), Targa::HEADER_SIZE)) {
+		return 0;
+	}
+	unsigned long long w = header[12] | (header[13] << 8), h = header[14] | (header[15] << 8);
+	unsigned char colour_depth = header[16];
+	if ((colour_depth != 8 && colour_depth != 24 && colour_depth != 32) || Targa::HEADER_SIZE + w * h * (colour_depth / 8) > entry.size) {
+		return 0;
+	}
+	file_.seekg(static_cast<std::streamoff>(entry.offset));
+	if (!image.Open(file_)) {
+		return 0;
+	}
+	return file_ ? 1 : 0;
+}
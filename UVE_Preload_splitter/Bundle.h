@@ -0,0 +1,51 @@
+#ifndef Bundle_h_
+#define Bundle_h_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include "Targa.h"
+#include "IniPreload.h"
+
+/*
+A single file holding many TGA frames.
+"UVEB", version, frames amount, then the index, then the TGA payloads back to back.
+Index entry: u64 offset, u32 size, then x, y, w, h, xo, yo of the preload frame the TGA was exported from.
+*/
+struct BundleFrame {
+	unsigned long long offset{ 0 };
+	unsigned int size{ 0 };
+	PreloadFrameData frame{};
+};
+
+class Bundle {
+public:
+	Bundle();
+	~Bundle();
+	// Writing
+	int Create(const std::string& path, int frames_amount);
+	int AddFrame(const Targa& image, const PreloadFrameData& frame);
+	int Close();
+	// Reading
+	int Open(const std::string& path);
+	int GetFrame(int index, Targa& image);
+
+	static bool IsBundlePath(const std::string& path);
+
+	static const unsigned int
+		MAGIC{ 0x42455655 }, // "UVEB"
+		VERSION{ 1 },
+		HEADER_SIZE{ 12 },
+		INDEX_ENTRY_SIZE{ 36 }
+	;
+	static const char* EXTENSION;
+
+	std::vector<BundleFrame> frames;
+
+private:
+	std::fstream file_;
+	int reserved_frames_;
+	bool writing_;
+};
+
+#endif // !Bundle_h_
@@ -0,0 +1,416 @@
+#include "Corpus.h"
+#include "Targa.h"
+#include "PackJob.h"
+#include "IniPreload.h"
+#include "Portability.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static const unsigned int CorpusVersions[3] = { IniPreload::VERSION_INT, IniPreload::VERSION_FLOAT, IniPreload::VERSION_INI };
+static const char* CorpusVersionNames[3] = { "int", "float", "ini" };
+static const char* WorkloadNames[4] = { "pack", "export", "sheet", "convert" };
+static const double REGRESSION_RATIO = 1.10; // Slower or bigger than this times the baseline
+static const double REGRESSION_MIN_MS = 5.0; // and slower by at least this, a few ms workload jitters more than 10%
+static const int WORKLOAD_RUNS = 3; // The fastest run counts
+
+struct WorkloadResult {
+	std::string name{};
+	double wall_ms{ 0 };
+	size_t peak_rss_kb{ 0 };
+	size_t output_bytes{ 0 };
+};
+
+struct FileState {
+	uintmax_t size{ 0 };
+	fs::file_time_type time{};
+};
+
+static size_t PeakRssKb() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return 0;
+	}
+	return counters.PeakWorkingSetSize >> 10;
+#else
+	rusage usage{};
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+#ifdef __APPLE__
+	return static_cast<size_t>(usage.ru_maxrss) >> 10; // Bytes there
+#else
+	return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+// One frame of animation: an ellipse going round the canvas and pulsing, so trimmed sizes and offsets differ.
+static void DrawFrame(Targa& frame, const CorpusSettings& settings, int animation, int index, std::mt19937& random) {
+	double turn = 6.283185307 * index / std::max(settings.frames, 1) + animation;
+	double scale = 0.75 + 0.25 * std::sin(turn * 2);
+	double rx = std::max(1.0, settings.sprite_w * scale / 2), ry = std::max(1.0, settings.sprite_h * scale / 2);
+	double cx = settings.canvas_w / 2.0 + std::max(0, settings.canvas_w - settings.sprite_w) / 2.0 * std::cos(turn);
+	double cy = settings.canvas_h / 2.0 + std::max(0, settings.canvas_h - settings.sprite_h) / 2.0 * std::sin(turn);
+	unsigned char* px = frame.data.data();
+	for (int y = 0; y < settings.canvas_h; ++y) {
+		for (int x = 0; x < settings.canvas_w; ++x, px += 4) {
+			double dx = (x - cx) / rx, dy = (y - cy) / ry;
+			double d = dx * dx + dy * dy;
+			unsigned char a = 0;
+			if (d < 1) {
+				switch (settings.alpha) {
+				case CORPUSALPHA_SOLID:
+					a = 255;
+					break;
+				case CORPUSALPHA_SOFT:
+					a = static_cast<unsigned char>(1 + 254 * (1 - d));
+					break;
+				default:
+					a = (random() & 3) ? 255 : 0;
+					break;
+				}
+			}
+			px[0] = a ? static_cast<unsigned char>(40 * animation + 8 * index) : 0; // b
+			px[1] = a ? static_cast<unsigned char>(255 * y / settings.canvas_h) : 0; // g
+			px[2] = a ? static_cast<unsigned char>(255 * x / settings.canvas_w) : 0; // r
+			px[3] = a;
+		}
+	}
+}
+
+static std::string AnimationDir(const std::string& dir, int animation) {
+	return (fs::path(dir) / ("anim_" + std::to_string(animation))).string();
+}
+
+static std::string AtlasName(int animation, int version) {
+	return "atlas_" + std::to_string(animation) + "_" + CorpusVersionNames[version] + ".tga";
+}
+
+int Corpus::AlphaFromName(const std::string& name) {
+	if (name == "solid") { return CORPUSALPHA_SOLID; }
+	if (name == "soft") { return CORPUSALPHA_SOFT; }
+	if (name == "noise") { return CORPUSALPHA_NOISE; }
+	return -1;
+}
+
+int Corpus::Generate(const std::string& dir, const CorpusSettings& settings) {
+	if (settings.canvas_w <= 0 || settings.canvas_h <= 0 || settings.frames <= 0 || settings.animations <= 0) {
+		printf_s("Nothing to generate, the corpus size is empty.\n");
+		return 0;
+	}
+	std::mt19937 random(1234);
+	TargaHeader header{};
+	header.w = static_cast<unsigned short>(settings.canvas_w);
+	header.h = static_cast<unsigned short>(settings.canvas_h);
+	header.image_type = 2;
+	header.colour_depth = 32;
+	header.image_descriptor = 8;
+	for (int a = 0; a < settings.animations; ++a) {
+		std::string anim_dir = AnimationDir(dir, a);
+		std::error_code error{};
+		fs::create_directories(anim_dir, error);
+		std::vector<PackInput> inputs{};
+		Targa frame{};
+		frame.SetHeader(header);
+		for (int f = 0; f < settings.frames; ++f) {
+			// A duplicate keeps the pixels of the frame before it.
+			if (f == 0 || settings.duplicates <= 0 || f % settings.duplicates) {
+				DrawFrame(frame, settings, a, f, random);
+			}
+			char name[32] = { 0 };
+			sprintf_s(name, "frame_%04d.tga", f);
+			PackInput input{};
+			input.tga = (fs::path(anim_dir) / name).string();
+			if (!frame.Save(input.tga)) {
+				printf_s("An error occurred when trying to read/write %s.\n", input.tga.c_str());
+				return 0;
+			}
+			inputs.push_back(input);
+		}
+		for (int v = 0; v < 3; ++v) {
+			PackJob job{};
+			job.id = a;
+			job.inputs = inputs;
+			for (PackInput& input : job.inputs) {
+				input.preload_version = CorpusVersions[v];
+			}
+			job.settings.output = (fs::path(dir) / AtlasName(a, v)).string();
+			if (!job.Run()) {
+				printf_s("Could not pack %s.\n", job.settings.output.c_str());
+				return 0;
+			}
+		}
+		printf_s("Animation %d: %d frames and 3 atlases in %s.\n", a, settings.frames, anim_dir.c_str());
+	}
+	return 1;
+}
+
+static std::string Quote(const std::string& str) {
+	return "\"" + str + "\"";
+}
+
+static std::map<std::string, FileState> Snapshot(const std::string& dir) {
+	std::map<std::string, FileState> files{};
+	std::error_code error{};
+	for (fs::recursive_directory_iterator it(dir, error), end; !error && it != end; it.increment(error)) {
+		if (it->is_regular_file(error)) {
+			files[it->path().string()] = { it->file_size(error), it->last_write_time(error) };
+		}
+	}
+	return files;
+}
+
+// Bytes of the files made or changed since before.
+static size_t OutputBytes(const std::map<std::string, FileState>& before, const std::string& dir) {
+	size_t bytes = 0;
+	for (const auto& file : Snapshot(dir)) {
+		auto found = before.find(file.first);
+		if (found == before.end() || found->second.size != file.second.size || found->second.time != file.second.time) {
+			bytes += static_cast<size_t>(file.second.size);
+		}
+	}
+	return bytes;
+}
+
+static bool CopyToWork(const std::string& dir, const std::string& name, const std::string& work) {
+	std::error_code error{};
+	fs::copy_file(fs::path(dir) / name, fs::path(work) / name, fs::copy_options::overwrite_existing, error);
+	if (error) {
+		printf_s("%s is missing, was the corpus made with --corpus?\n", (fs::path(dir) / name).string().c_str());
+		return false;
+	}
+	return true;
+}
+
+// Manifest lines of a workload. Inputs the workload changes or writes next to are copied to work first.
+static bool WorkloadLines(int workload, const std::string& dir, const std::string& work, int animations, std::vector<std::string>& lines) {
+	for (int a = 0; a < animations; ++a) {
+		std::string line{};
+		switch (workload) {
+		case 0: {
+			std::vector<std::string> frames{};
+			std::error_code error{};
+			for (fs::directory_iterator it(AnimationDir(dir, a), error), end; !error && it != end; it.increment(error)) {
+				frames.push_back(it->path().string());
+			}
+			std::sort(frames.begin(), frames.end());
+			line = "-ps --pack float";
+			for (const std::string& frame : frames) {
+				line += " " + Quote(frame);
+			}
+			line += " --out " + Quote((fs::path(work) / ("pack_" + std::to_string(a) + ".tga")).string());
+			lines.push_back(line);
+			break;
+		}
+		case 1:
+		case 2: {
+			int v = (workload == 1) ? 0 : 1;
+			std::string atlas = AtlasName(a, v);
+			std::string preload = atlas + Atlas::PreloadExtension(CorpusVersions[v]);
+			if (!CopyToWork(dir, atlas, work) || !CopyToWork(dir, preload, work)) {
+				return false;
+			}
+			line = (workload == 1) ? "-ps -e " : "-ps --sprite-sheet v -e ";
+			lines.push_back(line + Quote((fs::path(work) / atlas).string()) + " " + Quote((fs::path(work) / preload).string()));
+			break;
+		}
+		default: {
+			std::string from_ini = AtlasName(a, 2) + Atlas::PreloadExtension(IniPreload::VERSION_INI);
+			std::string from_int = AtlasName(a, 0) + Atlas::PreloadExtension(IniPreload::VERSION_INT);
+			if (!CopyToWork(dir, from_ini, work) || !CopyToWork(dir, from_int, work)) {
+				return false;
+			}
+			lines.push_back("-ps -c float " + Quote((fs::path(work) / from_ini).string()));
+			lines.push_back("-ps -c ini " + Quote((fs::path(work) / from_int).string()));
+			break;
+		}
+		}
+	}
+	return true;
+}
+
+static int CountAnimations(const std::string& dir) {
+	int animations = 0;
+	std::error_code error{};
+	while (fs::is_directory(AnimationDir(dir, animations), error)) {
+		++animations;
+	}
+	return animations;
+}
+
+static bool LoadResults(const std::string& path, std::vector<WorkloadResult>& results) {
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+	std::string line{};
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		std::istringstream fields(line);
+		WorkloadResult result{};
+		if (fields >> result.name >> result.wall_ms >> result.peak_rss_kb >> result.output_bytes) {
+			results.push_back(result);
+		}
+	}
+	return true;
+}
+
+static double Change(double now, double before) {
+	return before ? (now / before - 1) * 100 : 0;
+}
+
+// Prints every workload against the baseline. Returns the amount of regressions.
+static int CompareResults(const std::vector<WorkloadResult>& results, const std::vector<WorkloadResult>& baseline) {
+	int regressions = 0;
+	printf_s("\n%-8s %12s %8s %10s %8s %14s\n", "Workload", "Wall ms", "Change", "Peak KB", "Change", "Output bytes");
+	for (const WorkloadResult& result : results) {
+		auto base = std::find_if(baseline.begin(), baseline.end(), [&](const WorkloadResult& b) { return b.name == result.name; });
+		if (base == baseline.end()) {
+			printf_s("%-8s %12.1f %8s %10zu %8s %14zu (not in the baseline)\n", result.name.c_str(), result.wall_ms, "", result.peak_rss_kb, "", result.output_bytes);
+			continue;
+		}
+		bool slower = result.wall_ms > base->wall_ms * REGRESSION_RATIO && result.wall_ms - base->wall_ms > REGRESSION_MIN_MS;
+		bool bigger = result.peak_rss_kb > base->peak_rss_kb * REGRESSION_RATIO;
+		bool changed = result.output_bytes != base->output_bytes;
+		printf_s("%-8s %12.1f %+7.1f%% %10zu %+7.1f%% %14zu%s%s%s\n", result.name.c_str(),
+			result.wall_ms, Change(result.wall_ms, base->wall_ms),
+			result.peak_rss_kb, Change(static_cast<double>(result.peak_rss_kb), static_cast<double>(base->peak_rss_kb)),
+			result.output_bytes,
+			slower ? " SLOWER" : "", bigger ? " MORE MEMORY" : "", changed ? " OUTPUT CHANGED" : "");
+		regressions += (slower || bigger || changed) ? 1 : 0;
+	}
+	return regressions;
+}
+
+int Corpus::Run(const std::string& exe, const std::string& dir, const std::string& baseline, int threads) {
+	int animations = CountAnimations(dir);
+	if (animations == 0) {
+		printf_s("%s has no anim_0 folder, make the corpus with --corpus first.\n", dir.c_str());
+		return 0;
+	}
+	// Read before results.txt is written, the baseline may be the one in the folder.
+	std::vector<WorkloadResult> base{};
+	if (!baseline.empty() && !LoadResults(baseline, base)) {
+		printf_s("An error occurred when trying to read/write %s.\n", baseline.c_str());
+		return 0;
+	}
+	fs::path out = fs::path(dir) / "out";
+	std::vector<WorkloadResult> results{};
+	int result = 1;
+	for (int w = 0; w < 4; ++w) {
+		std::string work = (out / WorkloadNames[w]).string();
+		std::string manifest = (out / (std::string(WorkloadNames[w]) + ".manifest")).string();
+		std::string stats = (out / (std::string(WorkloadNames[w]) + ".stats")).string();
+		std::string log = (out / (std::string(WorkloadNames[w]) + ".log")).string();
+		WorkloadResult workload{};
+		workload.name = WorkloadNames[w];
+		// Every run starts from fresh copies, conversions change their inputs.
+		for (int run = 0; run < WORKLOAD_RUNS; ++run) {
+			std::error_code error{};
+			fs::remove_all(work, error);
+			fs::create_directories(work, error);
+			std::vector<std::string> lines{};
+			if (!WorkloadLines(w, dir, work, animations, lines)) {
+				return 0;
+			}
+			{
+				std::ofstream file(manifest, std::ios::trunc);
+				for (const std::string& line : lines) {
+					file << line << '\n';
+				}
+				if (!file) {
+					printf_s("An error occurred when trying to read/write %s.\n", manifest.c_str());
+					return 0;
+				}
+			}
+			fs::remove(stats, error);
+			std::map<std::string, FileState> before = Snapshot(work);
+
+			std::string command = Quote(exe) + " --threads " + std::to_string(threads) + " --manifest " + Quote(manifest)
+				+ " --stats-file " + Quote(stats) + " > " + Quote(log) + " 2>&1";
+#ifdef _WIN32
+			command = Quote(command); // cmd drops the outer quotes
+#endif
+			auto start = std::chrono::steady_clock::now();
+			std::system(command.c_str());
+			double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			size_t output_bytes = OutputBytes(before, work);
+
+			size_t peak_rss_kb = 0;
+			int errors = -1;
+			std::ifstream stats_file(stats);
+			if (!(stats_file >> peak_rss_kb >> errors) || errors) {
+				printf_s("Workload %s failed, see %s.\n", WorkloadNames[w], log.c_str());
+				result = 0;
+			}
+			if (run == 0 || wall_ms < workload.wall_ms) {
+				workload.wall_ms = wall_ms;
+			}
+			if (run == 0 || peak_rss_kb < workload.peak_rss_kb) {
+				workload.peak_rss_kb = peak_rss_kb;
+			}
+			workload.output_bytes = output_bytes;
+		}
+		printf_s("%-8s %10.1f ms %10zu KB peak %14zu bytes written (best of %d)\n", workload.name.c_str(), workload.wall_ms, workload.peak_rss_kb, workload.output_bytes, WORKLOAD_RUNS);
+		results.push_back(workload);
+	}
+
+	// Written aside and renamed, a failed write leaves the old results.
+	std::string results_path = (fs::path(dir) / "results.txt").string();
+	std::string temp = results_path + ".tmp";
+	{
+		std::ofstream file(temp, std::ios::trunc);
+		file << "# workload wall_ms peak_rss_kb output_bytes\n";
+		for (const WorkloadResult& workload : results) {
+			file << workload.name << ' ' << workload.wall_ms << ' ' << workload.peak_rss_kb << ' ' << workload.output_bytes << '\n';
+		}
+		file.close();
+		std::error_code error{};
+		if (file) {
+			fs::rename(temp, results_path, error);
+		}
+		if (!file || error) {
+			printf_s("An error occurred when trying to read/write %s.\n", results_path.c_str());
+			result = 0;
+		}
+	}
+
+	if (!baseline.empty()) {
+		int regressions = CompareResults(results, base);
+		if (regressions) {
+			printf_s("%d workloads regressed against %s.\n", regressions, baseline.c_str());
+			result = 0;
+		}
+	}
+	return result;
+}
+
+int Corpus::SaveStats(const std::string& path, int errors) {
+	std::ofstream file(path, std::ios::trunc);
+	file << PeakRssKb() << ' ' << errors << '\n';
+	return file ? 1 : 0;
+}
@@ -0,0 +1,36 @@
+#ifndef Corpus_h_
+#define Corpus_h_
+
+#include <string>
+
+enum CorpusAlpha {
+	CORPUSALPHA_SOLID, // Opaque sprite, hard edge
+	CORPUSALPHA_SOFT, // Alpha falls off towards the edge
+	CORPUSALPHA_NOISE // Scattered see-through pixels inside the sprite
+};
+
+struct CorpusSettings {
+	int canvas_w{ 256 }, canvas_h{ 256 };
+	int sprite_w{ 96 }, sprite_h{ 96 };
+	int frames{ 24 };
+	int animations{ 6 };
+	int alpha{ CORPUSALPHA_SOFT };
+	int duplicates{ 0 }; // Every n-th frame repeats the one before it, 0 - none
+};
+
+/*
+--corpus: writes synthetic animations (anim_N/frame_NNNN.tga) and packs each into int, float and ini atlases (atlas_N_[version].tga).
+--run-corpus: runs pack, export, sprite sheet export and convert over a corpus, each in its own process of this exe,
+and records wall time, peak RSS and output bytes to results.txt. Given a baseline results file, it reports what got worse.
+*/
+class Corpus {
+public:
+	static int Generate(const std::string& dir, const CorpusSettings& settings);
+	//exe is this executable. Returns 1 if every workload ran and nothing regressed against the baseline.
+	static int Run(const std::string& exe, const std::string& dir, const std::string& baseline, int threads);
+	//For --stats-file: the peak RSS (KB) of this process and the errors met.
+	static int SaveStats(const std::string& path, int errors);
+	static int AlphaFromName(const std::string& name);
+};
+
+#endif // !Corpus_h_
@@ -0,0 +1,129 @@
+#include "DirWatcher.h"
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#ifdef _WIN32
+DirWatcher::DirWatcher() : change_(INVALID_HANDLE_VALUE) {}
+#else
+DirWatcher::DirWatcher() : inotify_(-1) {}
+#endif
+
+DirWatcher::~DirWatcher() {
+	Close();
+}
+
+#ifdef _WIN32
+int DirWatcher::Open(const std::string& dir) {
+	Close();
+	// Change notifications cover subfolders on their own, no need to add every one.
+	change_ = FindFirstChangeNotificationA(dir.c_str(), TRUE,
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+	return change_ != INVALID_HANDLE_VALUE ? 1 : 0;
+}
+
+void DirWatcher::Close() {
+	if (change_ != INVALID_HANDLE_VALUE) {
+		FindCloseChangeNotification(change_);
+		change_ = INVALID_HANDLE_VALUE;
+	}
+}
+
+int DirWatcher::WaitChange(unsigned long timeout_ms) {
+	DWORD result = WaitForSingleObject(change_, timeout_ms);
+	if (result == WAIT_TIMEOUT) {
+		return 0;
+	}
+	if (result != WAIT_OBJECT_0 || !FindNextChangeNotification(change_)) {
+		return -1;
+	}
+	return 1;
+}
+
+int DirWatcher::Wait(int quiet_ms) {
+	if (change_ == INVALID_HANDLE_VALUE || WaitChange(INFINITE) < 0) {
+		return 0;
+	}
+	int result = 1;
+	while ((result = WaitChange(static_cast<unsigned long>(quiet_ms))) > 0) {}
+	return result == 0 ? 1 : 0;
+}
+#else
+int DirWatcher::AddWatches(const std::string& dir) {
+	const uint32_t mask = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB;
+	int watch = inotify_add_watch(inotify_, dir.c_str(), mask);
+	if (watch < 0) {
+		return 0;
+	}
+	watches_[watch] = dir;
+	// inotify watches a folder only, its subfolders need watches of their own.
+	std::error_code error{};
+	for (std::filesystem::recursive_directory_iterator it(dir, error), end; !error && it != end; it.increment(error)) {
+		std::error_code entry_error{};
+		if (it->is_directory(entry_error)) {
+			watch = inotify_add_watch(inotify_, it->path().c_str(), mask);
+			if (watch >= 0) {
+				watches_[watch] = it->path().string();
+			}
+		}
+	}
+	return 1;
+}
+
+int DirWatcher::Open(const std::string& dir) {
+	Close();
+	inotify_ = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	if (inotify_ < 0 || !AddWatches(dir)) {
+		Close();
+		return 0;
+	}
+	return 1;
+}
+
+void DirWatcher::Close() {
+	if (inotify_ >= 0) {
+		close(inotify_);
+		inotify_ = -1;
+	}
+	watches_.clear();
+}
+
+int DirWatcher::ReadEvents(int timeout_ms) {
+	pollfd fd{ inotify_, POLLIN, 0 };
+	int ready = poll(&fd, 1, timeout_ms);
+	if (ready <= 0) {
+		return ready;
+	}
+	alignas(inotify_event) char buffer[4096];
+	ssize_t got = 0;
+	while ((got = read(inotify_, buffer, sizeof(buffer))) > 0) {
+		// New subfolders get watched too, their files may be inputs.
+		for (char* at = buffer; at < buffer + got;) {
+			inotify_event* event = reinterpret_cast<inotify_event*>(at);
+			auto folder = watches_.find(event->wd);
+			if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && (event->mask & IN_ISDIR) && event->len && folder != watches_.end()) {
+				AddWatches((std::filesystem::path(folder->second) / event->name).string());
+			}
+			at += sizeof(inotify_event) + event->len;
+		}
+	}
+	return 1;
+}
+
+int DirWatcher::Wait(int quiet_ms) {
+	if (inotify_ < 0 || ReadEvents(-1) < 0) {
+		return 0;
+	}
+	int result = 1;
+	while ((result = ReadEvents(quiet_ms)) > 0) {}
+	return result == 0 ? 1 : 0;
+}
+#endif
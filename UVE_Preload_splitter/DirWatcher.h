@@ -0,0 +1,36 @@
+#ifndef DirWatcher_h_
+#define DirWatcher_h_
+
+#include <string>
+#include <map>
+
+/*
+--watch: tells when anything in a folder or its subfolders is written, created, renamed or removed.
+Which files changed is left to the caller, a save often touches several files (temporary copies, renames).
+*/
+class DirWatcher {
+public:
+	DirWatcher();
+	~DirWatcher();
+	DirWatcher(const DirWatcher&) = delete;
+	DirWatcher& operator=(const DirWatcher&) = delete;
+
+	int Open(const std::string& dir);
+	void Close();
+	//Blocks until something changes, then until nothing has changed for quiet_ms, so a burst of writes is one change. 0 on error.
+	int Wait(int quiet_ms);
+
+private:
+#ifdef _WIN32
+	void* change_;
+	int WaitChange(unsigned long timeout_ms);
+#else
+	int inotify_;
+	std::map<int, std::string> watches_; // Folder of every watch descriptor
+	int AddWatches(const std::string& dir);
+	//1 if events were read before timeout_ms (-1 - forever) ran out, 0 if not, -1 on error.
+	int ReadEvents(int timeout_ms);
+#endif
+};
+
+#endif // !DirWatcher_h_
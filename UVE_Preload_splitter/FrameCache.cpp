@@ -0,0 +1,60 @@
+#include "FrameCache.h"
+#include "PixelPool.h"
+#include <filesystem>
+
+static std::string FramesKey(const std::string& file, bool greyscale) {
+	std::error_code error{};
+	std::filesystem::path path = std::filesystem::absolute(file, error);
+	return (error ? file : path.lexically_normal().generic_string()) + (greyscale ? "|8" : "|32");
+}
+
+int FrameCache::Stamp(const std::string& file, FileStamp& stamp) {
+	std::error_code error{};
+	stamp.size = static_cast<unsigned long long>(std::filesystem::file_size(file, error));
+	if (error) {
+		return 0;
+	}
+	stamp.time = static_cast<long long>(std::filesystem::last_write_time(file, error).time_since_epoch().count());
+	return error ? 0 : 1;
+}
+
+bool FrameCache::Find(const std::string& file, bool greyscale, FileStamp& stamp, std::vector<AtlasEntry>& entries) {
+	stamp = FileStamp{};
+	if (!Stamp(file, stamp)) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto found = files_.find(FramesKey(file, greyscale));
+	if (found == files_.end() || found->second.stamp != stamp) {
+		return false;
+	}
+	entries = found->second.entries;
+	return true;
+}
+
+void FrameCache::Set(const std::string& file, bool greyscale, const FileStamp& stamp, const std::vector<AtlasEntry>& entries) {
+	if (stamp.size == 0 && stamp.time == 0) {
+		return;
+	}
+	CachedFrames frames{};
+	frames.stamp = stamp;
+	{
+		// Kept past the job, so not counted as its sources nor to it at all.
+		PixelScope memory(PIXCAT_OTHER, PIXJOB_NONE);
+		frames.entries = entries;
+	}
+	for (const AtlasEntry& entry : frames.entries) {
+		frames.bytes += entry.image.PixelsSize();
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	files_[FramesKey(file, greyscale)] = std::move(frames);
+}
+
+size_t FrameCache::Bytes() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	size_t bytes = 0;
+	for (const auto& file : files_) {
+		bytes += file.second.bytes;
+	}
+	return bytes;
+}
@@ -0,0 +1,43 @@
+#ifndef FrameCache_h_
+#define FrameCache_h_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include "AtlasPack.h"
+
+struct FileStamp {
+	unsigned long long size{ 0 };
+	long long time{ 0 }; // Last write time, in the file clock's ticks
+	bool operator==(const FileStamp& other) const { return size == other.size && time == other.time; }
+	bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+/*
+--watch: trimmed and cropped pack inputs kept in memory between runs, so inputs that haven't changed are neither read nor trimmed again.
+A file is known by its path, size, last write time and whether it was made greyscale. Shared by the pack jobs of a run.
+*/
+class FrameCache {
+public:
+	//Copies the entries of file into entries if it hasn't changed since Set(). stamp is what the file is like now.
+	bool Find(const std::string& file, bool greyscale, FileStamp& stamp, std::vector<AtlasEntry>& entries);
+	//Keeps copies of the cropped entries of file, read when it was like stamp (from Find(), taken before reading).
+	void Set(const std::string& file, bool greyscale, const FileStamp& stamp, const std::vector<AtlasEntry>& entries);
+	size_t Bytes();
+
+	//0 if the file can't be found.
+	static int Stamp(const std::string& file, FileStamp& stamp);
+
+private:
+	struct CachedFrames {
+		FileStamp stamp{};
+		std::vector<AtlasEntry> entries{};
+		size_t bytes{ 0 };
+	};
+
+	std::map<std::string, CachedFrames> files_;
+	std::mutex mutex_;
+};
+
+#endif // !FrameCache_h_
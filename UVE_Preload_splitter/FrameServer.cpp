@@ -0,0 +1,280 @@
+#include "FrameServer.h"
+#include "Library.h"
+#include "Portability.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET SocketHandle;
+#define CloseSocket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <csignal>
+typedef int SocketHandle;
+#define CloseSocket close
+#define INVALID_SOCKET (-1)
+#endif
+// A client gone mid-reply must end that client, not raise SIGPIPE and kill the server.
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+const size_t FrameServer::DEFAULT_MAX_BYTES = size_t(2048) << 20;
+
+FrameServer::FrameServer(size_t max_bytes) : max_bytes_(max_bytes), bytes_(0), hits_(0), misses_(0) {}
+
+static std::string SplitField(const std::string& line, size_t& pos) {
+	if (pos > line.size()) {
+		return std::string();
+	}
+	size_t tab = line.find('\t', pos);
+	if (tab == std::string::npos) {
+		tab = line.size();
+	}
+	std::string field = line.substr(pos, tab - pos);
+	pos = tab + 1;
+	return field;
+}
+
+std::shared_ptr<const FrameServer::CachedAtlas> FrameServer::Get(const std::string& tga, const std::string& preload, std::string& error) {
+	std::string preload_path = preload;
+	if (preload_path.empty()) {
+		std::error_code exists_error{};
+		preload_path = std::filesystem::exists(tga + ".ini.preload", exists_error) ? tga + ".ini.preload" : tga + ".ini";
+	}
+	std::error_code path_error{};
+	std::string key = std::filesystem::absolute(tga, path_error).lexically_normal().generic_string() + '\t'
+		+ std::filesystem::absolute(preload_path, path_error).lexically_normal().generic_string();
+	FileStamp tga_stamp{}, preload_stamp{};
+	if (!FrameCache::Stamp(tga, tga_stamp) || !FrameCache::Stamp(preload_path, preload_stamp)) {
+		error = "no such atlas or preload";
+		return nullptr;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto found = atlases_.find(key);
+		if (found != atlases_.end() && found->second.atlas->tga_stamp == tga_stamp && found->second.atlas->preload_stamp == preload_stamp) {
+			used_.splice(used_.begin(), used_, found->second.used);
+			++hits_;
+			return found->second.atlas;
+		}
+		++misses_;
+	}
+
+	// Read without the lock, other atlases are served meanwhile.
+	std::shared_ptr<CachedAtlas> atlas = std::make_shared<CachedAtlas>();
+	atlas->tga = tga;
+	atlas->preload_path = preload_path;
+	atlas->tga_stamp = tga_stamp;
+	atlas->preload_stamp = preload_stamp;
+	// Read into memory, not mapped: an atlas saved over while cached would be cut short under a mapping.
+	if (!atlas->image.Open(tga)) {
+		error = "can't read the atlas";
+		return nullptr;
+	}
+	// Caught in the middle of a save: shorter than its header says, or changed while it was read.
+	FileStamp read_stamp{};
+	if (tga_stamp.size < Targa::HEADER_SIZE + atlas->image.PixelsSize() || !FrameCache::Stamp(tga, read_stamp) || read_stamp != tga_stamp) {
+		error = "the atlas is being saved, try again";
+		return nullptr;
+	}
+	if (!atlas->preload.Open(preload_path)) {
+		error = "can't read the preload";
+		return nullptr;
+	}
+	ExportSettings centered{};
+	centered.centered = true;
+	std::vector<int> all_ids = Library::SelectFrames(centered, static_cast<int>(atlas->preload.frames.size()));
+	atlas->centered_size = Library::ExportSize(centered, atlas->preload, all_ids);
+	atlas->bytes = atlas->image.PixelsSize() + atlas->preload.frames.size() * sizeof(PreloadFrameData);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto found = atlases_.find(key);
+	if (found != atlases_.end()) {
+		bytes_ -= found->second.atlas->bytes;
+		used_.erase(found->second.used);
+		atlases_.erase(found);
+	}
+	used_.push_front(key);
+	atlases_[key] = { atlas, used_.begin() };
+	bytes_ += atlas->bytes;
+	Evict();
+	return atlas;
+}
+
+void FrameServer::Evict() {
+	// The atlas just used is never dropped, even if it alone is over the limit.
+	while (bytes_ > max_bytes_ && used_.size() > 1) {
+		auto found = atlases_.find(used_.back());
+		bytes_ -= found->second.atlas->bytes;
+		atlases_.erase(found);
+		used_.pop_back();
+	}
+}
+
+void FrameServer::Answer(const std::string& request, std::string& reply) {
+	size_t pos = 0;
+	std::string command = SplitField(request, pos);
+	if (command == "stats") {
+		std::lock_guard<std::mutex> lock(mutex_);
+		reply = "OK " + std::to_string(atlases_.size()) + ' ' + std::to_string(bytes_) + ' '
+			+ std::to_string(hits_) + ' ' + std::to_string(misses_) + '\n';
+		return;
+	}
+	if (command != "frame") {
+		reply = "ERR unknown request\n";
+		return;
+	}
+	std::string index_field = SplitField(request, pos);
+	std::string mode = SplitField(request, pos);
+	std::string tga = SplitField(request, pos);
+	std::string preload = SplitField(request, pos);
+	char* end = nullptr;
+	long index = std::strtol(index_field.c_str(), &end, 10);
+	if (index_field.empty() || *end != '\0' || (mode != "centered" && mode != "trimmed") || tga.empty()) {
+		reply = "ERR bad request, expected frame<tab>index<tab>centered|trimmed<tab>atlas[<tab>preload]\n";
+		return;
+	}
+	std::string error{};
+	std::shared_ptr<const CachedAtlas> atlas = Get(tga, preload, error);
+	if (!atlas) {
+		reply = "ERR " + error + '\n';
+		return;
+	}
+	if (index < 0 || index >= static_cast<long>(atlas->preload.frames.size())) {
+		reply = "ERR no frame " + index_field + ", there are " + std::to_string(atlas->preload.frames.size()) + '\n';
+		return;
+	}
+
+	const PreloadFrameData& frame = atlas->preload.frames[index];
+	bool src_bottom_to_top = (atlas->preload.format_version == IniPreload::VERSION_FLOAT);
+	TargaHeader header = atlas->image.GetHeader();
+	Targa image{};
+	int drawn = 0;
+	if (mode == "trimmed") {
+		header.w = frame.w;
+		header.h = frame.h;
+		image.SetHeader(header);
+		drawn = image.CopyRegion(atlas->image, frame.x, frame.y, 0, 0, frame.w, frame.h, src_bottom_to_top, true);
+	}
+	else {
+		header.w = atlas->centered_size.w;
+		header.h = atlas->centered_size.h;
+		image.SetHeader(header);
+		// Not flipped: row 0 of the pixels is the top one.
+		ExportSettings centered{};
+		centered.centered = true;
+		centered.flip = false;
+		drawn = Library::DrawFrame(atlas->image, frame, frame.y, src_bottom_to_top, atlas->centered_size, centered, image);
+	}
+	if (!drawn) {
+		reply = "ERR frame " + index_field + " is outside of the atlas\n";
+		return;
+	}
+	char line[128] = { 0 };
+	sprintf_s(line, "OK %d %d %d %zu %g %g\n", image.w, image.h, image.colour_depth, image.PixelsSize(), frame.xo, frame.yo);
+	reply.assign(line);
+	reply.append(reinterpret_cast<const char*>(image.Pixels()), image.PixelsSize());
+}
+
+static bool SendAll(SocketHandle socket, const std::string& bytes) {
+	size_t sent = 0;
+	while (sent < bytes.size()) {
+		int chunk = static_cast<int>(std::min<size_t>(bytes.size() - sent, size_t(1) << 30));
+		int result = static_cast<int>(send(socket, bytes.data() + sent, chunk, MSG_NOSIGNAL));
+		if (result <= 0) {
+			return false;
+		}
+		sent += static_cast<size_t>(result);
+	}
+	return true;
+}
+
+void FrameServer::Serve(intptr_t client) {
+	SocketHandle socket = static_cast<SocketHandle>(client);
+	std::string pending{}, reply{};
+	char buffer[4096];
+	int got = 0;
+	while ((got = static_cast<int>(recv(socket, buffer, sizeof(buffer), 0))) > 0) {
+		pending.append(buffer, static_cast<size_t>(got));
+		size_t line_end = 0;
+		while ((line_end = pending.find('\n')) != std::string::npos) {
+			std::string request = pending.substr(0, line_end);
+			pending.erase(0, line_end + 1);
+			if (!request.empty() && request.back() == '\r') {
+				request.pop_back();
+			}
+			if (request.empty()) {
+				continue;
+			}
+			// Big atlases or --memory-limit may not fit, that's one failed request, not the end of the server.
+			try {
+				Answer(request, reply);
+			}
+			catch (const std::bad_alloc&) {
+				reply = "ERR out of memory\n";
+			}
+			if (!SendAll(socket, reply)) {
+				CloseSocket(socket);
+				return;
+			}
+		}
+	}
+	CloseSocket(socket);
+}
+
+int FrameServer::Run(const std::string& socket_path) {
+#ifdef _WIN32
+	WSADATA wsa{};
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+		return 0;
+	}
+#elif !MSG_NOSIGNAL
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(address.sun_path)) {
+		printf_s("The socket path %s is too long.\n", socket_path.c_str());
+		return 0;
+	}
+	std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size());
+	// A socket file left by a server that was stopped is replaced, anything else at the path is kept.
+	std::error_code error{};
+	if (std::filesystem::exists(socket_path, error)) {
+		if (!std::filesystem::is_socket(socket_path, error)) {
+			printf_s("%s exists and isn't a socket, it's left alone.\n", socket_path.c_str());
+			return 0;
+		}
+		std::filesystem::remove(socket_path, error);
+	}
+	SocketHandle listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == INVALID_SOCKET) {
+		return 0;
+	}
+	if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0) {
+		CloseSocket(listener);
+		return 0;
+	}
+	printf_s("Serving frames on %s, press Ctrl+C to stop.\n", socket_path.c_str());
+	SocketHandle client = INVALID_SOCKET;
+	while ((client = accept(listener, nullptr, nullptr)) != INVALID_SOCKET) {
+		// A client per thread, they share the cache.
+		std::thread(&FrameServer::Serve, this, static_cast<intptr_t>(client)).detach();
+	}
+	CloseSocket(listener);
+	std::filesystem::remove(socket_path, error);
+	return 1;
+}
@@ -0,0 +1,62 @@
+#ifndef FrameServer_h_
+#define FrameServer_h_
+
+#include <string>
+#include <map>
+#include <list>
+#include <memory>
+#include <cstdint>
+#include <mutex>
+#include "Targa.h"
+#include "IniPreload.h"
+#include "FrameCache.h"
+
+/*
+--serve: answers frame requests on a local (Unix domain) socket, keeping the atlases and preloads it has read in an LRU cache.
+A request is a line of tab separated fields, a reply is a text line and, for frames, the pixels right after it:
+	frame	<index>	<centered|trimmed>	<atlas TGA>	[preload]
+		OK <w> <h> <bits per pixel> <bytes> <xo> <yo>
+		Rows top to bottom, pixels as the TGA stores them (BGRA, BGR or grey). Centered frames are all as big as
+		the animation's exported frames, with the middle in the middle. Trimmed ones are the frame's rect of the atlas.
+	stats
+		OK <atlases> <bytes> <hits> <misses>
+Errors are "ERR <message>". The preload is the atlas path + .ini.preload or .ini if not given.
+Cached atlases are checked against their files on every request and read again when changed.
+*/
+class FrameServer {
+public:
+	explicit FrameServer(size_t max_bytes);
+	//Serves until the socket fails. 0 if it can't be made.
+	int Run(const std::string& socket_path);
+	//The reply to one request line (without its end): the reply line with its end, then the pixels if any.
+	void Answer(const std::string& request, std::string& reply);
+
+	static const size_t DEFAULT_MAX_BYTES;
+
+private:
+	struct CachedAtlas {
+		std::string tga{}, preload_path{};
+		FileStamp tga_stamp{}, preload_stamp{};
+		Targa image{};
+		IniPreload preload{};
+		PreloadFrameData centered_size{}; // Export size of every frame, centered
+		size_t bytes{ 0 };
+	};
+	std::shared_ptr<const CachedAtlas> Get(const std::string& tga, const std::string& preload, std::string& error);
+	void Serve(intptr_t client);
+	// Under mutex_.
+	void Evict();
+
+	struct CacheSlot {
+		std::shared_ptr<const CachedAtlas> atlas{};
+		std::list<std::string>::iterator used{};
+	};
+	std::map<std::string, CacheSlot> atlases_;
+	std::list<std::string> used_; // Keys, most recently used first
+	size_t max_bytes_;
+	size_t bytes_;
+	long long hits_, misses_;
+	std::mutex mutex_;
+};
+
+#endif // !FrameServer_h_
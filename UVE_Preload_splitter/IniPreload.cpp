@@ -1,5 +1,8 @@
 #include "IniPreload.h"
+#include "Portability.h"
+#include "OutputCache.h"
 #include <fstream>
+#include <cmath>
 
 
 IniPreload::IniPreload() :
@@ -13,15 +16,34 @@ IniPreload::IniPreload() :
 IniPreload::~IniPreload() {}
 
 int IniPreload::Open(const std::string& f_path) {
-	// todo: add a routine for opening text versions!
 	std::ifstream file(f_path, std::ios::binary);
 	if (!file) {
 		return 0;
 	}
+	int first_word = 0;
+	file.read(reinterpret_cast<char*>(&first_word), 4);
+	if (first_word == 0x696B535B) { // "[Ski"
+		// Text mode, for the line ends.
+		file.close();
+		std::ifstream text(f_path);
+		if (!text) {
+			return 0;
+		}
+		return OpenIni(text);
+	}
+	file.seekg(0);
+	return Open(file);
+}
+
+int IniPreload::Open(std::istream& file) {
+	std::streampos start = file.tellg();
 	file.read(reinterpret_cast<char*>(&format_version), 4);
+	if (!file) {
+		return 0;
+	}
 	if (format_version == 0x696B535B) { // "[Ski"
-		file.close();
-		return OpenIni(f_path);
+		file.seekg(start);
+		return OpenIni(file);
 	}
 	file.read(reinterpret_cast<char*>(&width), 4);
 	file.read(reinterpret_cast<char*>(&height), 4);
@@ -53,16 +75,10 @@ int IniPreload::Open(const std::string& f_path) {
 		}
 		frames.push_back(frame);
 	}
-	file.close();
 	return 1;
 }
 
-int IniPreload::OpenIni(const std::string& f_path) {
-	std::ifstream file(f_path);
-	if (!file) {
-		return 0;
-	}
-
+int IniPreload::OpenIni(std::istream& file) {
 	frames_amount = 0;
 	file_format = VERSION_INI;
 	int frame_last = -1;
@@ -169,7 +185,6 @@ int IniPreload::OpenIni(const std::string& f_path) {
 		frames.push_back(frame);
 	}
 	file.clear();
-	file.close();
 	return 1;
 }
 
@@ -180,23 +195,31 @@ int IniPreload::SetVersion(const int& version) {
 
 
 int IniPreload::Save(const std::string& f_path) {
+	if (format_version != VERSION_INT && format_version != VERSION_FLOAT && format_version != VERSION_INI) {
+		return 0;
+	}
+	OutputCache::Unshare(f_path);
+	// INI preloads are text.
+	std::ofstream file(f_path, (format_version == VERSION_INI) ? std::ios::trunc : std::ios::trunc | std::ios::binary);
+	if (!file) {
+		return 0;
+	}
+	return Save(file) && file.flush() ? 1 : 0;
+}
+
+int IniPreload::Save(std::ostream& file) {
 	switch (format_version) {
 	case VERSION_INT:
 	case VERSION_FLOAT:
-		return (SaveIniPreload(f_path));
+		return (SaveIniPreload(file));
 	case VERSION_INI:
-		return (SaveIni(f_path));
+		return (SaveIni(file));
 	default:
 		return 0;
 	}
 }
 
-int IniPreload::SaveIniPreload(const std::string& f_path) {
-	std::ofstream file(f_path, std::ios::trunc | std::ios::binary);
-	if (!file) {
-		return 0;
-	}
-
+int IniPreload::SaveIniPreload(std::ostream& file) {
 	file.write(reinterpret_cast<char*>(&format_version), 4);
 	file.write(reinterpret_cast<char*>(&width), 4);
 	file.write(reinterpret_cast<char*>(&height), 4);
@@ -217,13 +240,10 @@ int IniPreload::SaveIniPreload(const std::string& f_path) {
 			file.write(reinterpret_cast<char*>(&iyo), 4);
 		}
 	}
-	file.close();
-	return 1;
+	return file ? 1 : 0;
 }
 
-int IniPreload::SaveIni(const std::string& f_path) {
-	std::ofstream file(f_path, std::ios::trunc);
-	if (!file) { return 0; }
+int IniPreload::SaveIni(std::ostream& file) {
 	for (int i = 0; i < frames_amount; ++i) {
 		file << "[Skin " << i << "]\n";
 		file << "left=" << frames[i].x << '\n';
@@ -236,8 +256,7 @@ int IniPreload::SaveIni(const std::string& f_path) {
 		if (iyo) { file << "origin_adjust_y=" << iyo << "\n"; }
 		if (i != frames_amount - 1) { file << "\n"; }
 	}
-	file.close();
-	return 1;
+	return file ? 1 : 0;
 }
 
 
@@ -3,6 +3,8 @@
 
 #include <string>
 #include <vector>
+#include <istream>
+#include <ostream>
 
 struct PreloadFrameData {
 	int x{0}, // + is right.
@@ -19,7 +21,10 @@ public:
 	IniPreload();
 	~IniPreload();
 	int Open(const std::string& f_path);
+	//Reads a binary or INI preload from any stream, an INI one has to be seekable.
+	int Open(std::istream& file);
 	int Save(const std::string& f_path);
+	int Save(std::ostream& file);
 	int SetVersion(const int& version);
 	void PrintFrames();
 	PreloadFrameData GetEntry(int index) const;
@@ -43,9 +48,9 @@ public:
 		frames_amount{0};
 	unsigned int file_format{0};
 private:
-	int SaveIni(const std::string& f_path);
-	int SaveIniPreload(const std::string& f_path);
-	int OpenIni(const std::string& f_path);
+	int SaveIni(std::ostream& file);
+	int SaveIniPreload(std::ostream& file);
+	int OpenIni(std::istream& file);
 };
 
 #endif
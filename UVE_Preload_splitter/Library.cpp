@@ -0,0 +1,261 @@
+#include "Library.h"
+#include "AtlasPack.h"
+#include "PixelPool.h"
+#include "Debug.h"
+#include "Portability.h"
+#include <cmath>
+#include <numeric>
+#include <sstream>
+
+#define MIDDLE(w) (static_cast<float>(w-1)/2.f) // Ceil this if called with width/height to get a pixel coordinate for middle.
+
+// Some of these are duplicated in AtlasPack.cpp and Targa.cpp.
+static const PixelData DebugColourMiddleAbs = { 255, 255, 0, 0 }; // Red absolute middle
+static const PixelData DebugColourOffset = { 255, 0, 0, 255 }; // Blue offset
+static const PixelData DebugColourFrame = { 255, 127, 127, 127 }; // 50% grey frame
+
+int Library::ReadTarga(const std::vector<char>& bytes, Targa& image) {
+	std::istringstream file(std::string(bytes.begin(), bytes.end()), std::ios::binary);
+	return image.Open(file);
+}
+
+int Library::WriteTarga(const Targa& image, std::vector<char>& bytes) {
+	std::ostringstream file(std::ios::binary);
+	image.Save(file);
+	if (!file) {
+		return 0;
+	}
+	std::string str = file.str();
+	bytes.assign(str.begin(), str.end());
+	return 1;
+}
+
+int Library::ReadPreload(const std::vector<char>& bytes, IniPreload& preload) {
+	std::istringstream file(std::string(bytes.begin(), bytes.end()), std::ios::binary);
+	preload = IniPreload{};
+	return preload.Open(file);
+}
+
+int Library::WritePreload(IniPreload& preload, std::vector<char>& bytes) {
+	std::ostringstream file(std::ios::binary);
+	if (!preload.Save(file)) {
+		return 0;
+	}
+	std::string str = file.str();
+	bytes.assign(str.begin(), str.end());
+	return 1;
+}
+
+std::vector<int> Library::SelectFrames(const ExportSettings& settings, int frames_amount, std::vector<int>* skipped) {
+	std::vector<int> frame_ids{};
+	if (!settings.range.Empty()) {
+		// long long, last + step may not fit an int.
+		for (long long j = settings.range.first; j <= settings.range.last && j < frames_amount; j += settings.range.step) {
+			frame_ids.push_back(static_cast<int>(j));
+		}
+		return frame_ids;
+	}
+	if (settings.frames.empty()) {
+		frame_ids.resize(frames_amount);
+		std::iota(frame_ids.begin(), frame_ids.end(), 0);
+		return frame_ids;
+	}
+	for (int j : settings.frames) {
+		if (j < frames_amount) {
+			frame_ids.push_back(j);
+		}
+		else if (skipped) {
+			skipped->push_back(j);
+		}
+	}
+	return frame_ids;
+}
+
+PreloadFrameData Library::ExportSize(const ExportSettings& settings, const IniPreload& preload, const std::vector<int>& frame_ids) {
+	PreloadFrameData sizes{ 0 };
+	int	wLeft = 0,
+		wRight = 0,
+		hTop = 0,
+		hBottom = 0;
+
+	for (size_t k = 0; k < frame_ids.size(); ++k) {
+		size_t i = frame_ids[k];
+		// Middle pixel index, starting from 0.
+		// For 33x33 m = 16;				L = m = 16, R = m+1 = 17
+		// For 32x32 m = ceil(15.5) = 16;	L = m = 16, R = m = 16.
+		int w_half = std::ceil(MIDDLE(preload.frames[i].w));
+
+		//if (preload.frames[i].xo >= 0) { // Image shifts right by xo pixels
+		//	wLeft = std::max(wLeft, w_half + 1);
+		//	wRight = std::max(wRight, static_cast<int>(
+		//		w_half + std::round(preload.frames[i].xo)
+		//		));
+		//}
+		//else {
+		//	wLeft = std::max(wLeft, static_cast<int>(
+		//		w_half - std::round(preload.frames[i].xo)
+		//		));
+		//	wRight = std::max(wRight, w_half);
+		//}
+
+		wLeft = std::max(wLeft, static_cast<int>(
+			w_half
+				- ((preload.frames[i].xo < 0) ? std::floor(preload.frames[i].xo + 0.5f) : 0)
+			));
+		wRight = std::max(wRight, static_cast<int>(
+			(w_half + ((preload.frames[i].w % 2 == 1) ? 1 : 0))
+				+ ((preload.frames[i].xo > 0) ? std::floor(preload.frames[i].xo + 0.5f) : 0)
+			));
+
+		int h_half = std::ceil(MIDDLE(preload.frames[i].h));
+		hTop = std::max(hTop, static_cast<int>(
+			h_half
+			- ((preload.frames[i].yo < 0) ? std::floor(preload.frames[i].yo + 0.5f) : 0)
+			));
+		hBottom = std::max(hBottom, static_cast<int>(
+			(h_half + ((preload.frames[i].h % 2 == 1) ? 1 : 0))
+			+ ((preload.frames[i].yo > 0) ? std::floor(preload.frames[i].yo + 0.5f) : 0)
+			));
+
+
+
+		//if (preload.frames[i].yo >= 0) {
+		//	hTop = std::max(hTop, h_half);
+		//	hBottom = std::max(hBottom, static_cast<int>(
+		//		h_half + preload.frames[i].yo
+		//		));
+		//}
+		//else {
+		//	hTop = std::max(hTop, static_cast<int>(
+		//		h_half - preload.frames[i].yo
+		//		));
+		//	hBottom = std::max(hBottom, h_half);
+		//}
+	}
+
+	// Middle point X Y
+	if (settings.centered) {
+		sizes.x = std::max(wLeft, wRight);
+		sizes.y = std::max(hTop, hBottom);
+		sizes.w = std::max(wLeft, wRight) * 2 + 1; // Making it odd so the middle is in the absolute middle.
+		sizes.h = std::max(hTop, hBottom) * 2 + 1;
+	}
+	else {
+		sizes.x = wLeft;
+		sizes.y = hTop;
+		sizes.w = wLeft + wRight;
+		sizes.h = hTop + hBottom;
+	}
+
+	DEBUG_PRINTVAL(hTop, "%d");
+	DEBUG_PRINTVAL(hBottom, "%d");
+	//DEBUG_PAUSE;
+	return sizes;
+}
+
+int Library::DrawFrame(const Targa& atlas, const PreloadFrameData& frame, int frame_y, bool bottom_to_top,
+	const PreloadFrameData& size, const ExportSettings& settings, Targa& image)
+{
+	// If for w=32 the middle is in x=15.5, then the true middle is 16 and every offset should be extra -0.5.
+	int middle_x = std::ceilf(MIDDLE(frame.w));
+	int middle_y = std::ceilf(MIDDLE(frame.h)); // True for CI4, have to check for other games. Y looks down.
+	int ixo = static_cast<int>(std::floor(frame.xo + 0.5));
+	int iyo = static_cast<int>(std::floor(frame.yo + 0.5));
+	if (!image.CopyRegion(atlas,
+			frame.x, frame_y,
+			size.x - middle_x + ixo,
+			size.y - middle_y + iyo,
+			frame.w, frame.h,
+			bottom_to_top,
+			!settings.flip
+		)
+	) {
+		return 0;
+	}
+
+	//Debug middle and middle with offset
+	if (settings.debug_middle) {
+		//Middle point of the global frame.
+		image.SetPixel(size.x, size.y, DebugColourMiddleAbs, !settings.flip);
+		//Middle point with an offset: the middle of the frame exported.
+		image.SetPixel(size.x + ixo, size.y + iyo, DebugColourOffset, !settings.flip);
+	}
+	if (settings.debug_frame) {
+		PixelData middle_colour{ DebugColourFrame.a, uint8_t(DebugColourFrame.r * 0.7), uint8_t(DebugColourFrame.g * 0.7), uint8_t(DebugColourFrame.b * 0.7) };
+		//Frame top and bottom
+		for (int x = 0; x < frame.w; ++x) {
+			image.SetPixel(size.x - middle_x + ixo + x, size.y - middle_y + iyo,
+				(x != middle_x) ? DebugColourFrame : middle_colour, !settings.flip);
+			image.SetPixel(size.x - middle_x + ixo + x, size.y - middle_y + iyo + frame.h - 1,
+				(x != middle_x) ? DebugColourFrame : middle_colour, !settings.flip);
+		}
+		//Frame sides
+		for (int y = 0; y < frame.h; ++y) {
+			image.SetPixel(size.x - middle_x + ixo, size.y - middle_y + iyo + y,
+				(y != middle_y) ? DebugColourFrame : middle_colour, !settings.flip);
+			image.SetPixel(size.x - middle_x + ixo + frame.w - 1, size.y - middle_y + iyo + y,
+				(y != middle_y) ? DebugColourFrame : middle_colour, !settings.flip);
+		}
+	}
+	return 1;
+}
+
+int Library::ExportFrames(const Targa& atlas, const IniPreload& preload, const ExportSettings& settings,
+	std::vector<Targa>& frames, std::vector<int>* frame_ids)
+{
+	PixelScope memory(PIXCAT_EXPORT);
+	frames.clear();
+	std::vector<int> ids = SelectFrames(settings, static_cast<int>(preload.frames.size()));
+	std::vector<int> size_ids = ids;
+	if (settings.global_size) {
+		size_ids.resize(preload.frames.size());
+		std::iota(size_ids.begin(), size_ids.end(), 0);
+	}
+	PreloadFrameData size = ExportSize(settings, preload, size_ids);
+	TargaHeader header = atlas.GetHeader();
+	header.w = size.w;
+	header.h = size.h;
+	bool bottom_to_top = (preload.format_version == IniPreload::VERSION_FLOAT);
+	for (int j : ids) {
+		Targa image{};
+		image.SetHeader(header);
+		if (!DrawFrame(atlas, preload.frames[j], preload.frames[j].y, bottom_to_top, size, settings, image)) {
+			continue;
+		}
+		frames.push_back(std::move(image));
+		if (frame_ids) {
+			frame_ids->push_back(j);
+		}
+	}
+	return static_cast<int>(frames.size());
+}
+
+int Library::PackFrames(std::vector<PackFrame>& frames, const PackSettings& settings, int preload_version,
+	int frames_amount, int loop_mode, Targa& atlas, std::vector<PackedPreload>& preloads)
+{
+	preloads.clear();
+	PackJob job{};
+	job.settings = settings;
+	job.inputs.resize(frames.size());
+	for (size_t i = 0; i < frames.size(); ++i) {
+		PackInput& input = job.inputs[i];
+		input.image = &frames[i].image;
+		input.group = frames[i].group;
+		input.frames = frames_amount;
+		input.loop = loop_mode;
+		input.preload_version = preload_version;
+	}
+	job.atlas_image = &atlas;
+	job.preloads = &preloads;
+	job.quiet = true;
+	int result = job.Run();
+	frames.clear();
+	return result;
+}
+
+int Library::ConvertPreload(IniPreload& preload, int version) {
+	if (version != IniPreload::VERSION_INT && version != IniPreload::VERSION_FLOAT && version != IniPreload::VERSION_INI) {
+		return 0;
+	}
+	return preload.SetVersion(version);
+}
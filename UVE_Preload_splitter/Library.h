@@ -0,0 +1,71 @@
+#ifndef Library_h_
+#define Library_h_
+
+#include <string>
+#include <vector>
+#include "Targa.h"
+#include "IniPreload.h"
+#include "PackJob.h"
+
+// --frames-range: first to last (both inclusive) every step frames.
+struct FrameRange {
+	int first{ 0 };
+	int last{ -1 }; // Below first - no range
+	int step{ 1 };
+	bool Empty() const { return last < first; }
+};
+
+// How frames are exported, the same as the export options of the command line.
+struct ExportSettings {
+	bool centered{ false }; // --centered
+	bool flip{ true }; // -f
+	bool global_size{ false }; // --global-size
+	std::vector<int> frames{}; // --frame-list
+	FrameRange range{}; // --frames-range, frames and range both empty - all
+	bool debug_middle{ false };
+	bool debug_frame{ false };
+};
+
+// A frame to pack, for PackFrames(). Frames of one group share a preload.
+struct PackFrame {
+	Targa image{};
+	int group{ 0 };
+};
+
+/*
+Export, pack and convert without files or a process of their own, for tools that link this in.
+Images and preloads come and go as Targa and IniPreload objects, or as file bytes with the Read/Write functions.
+Nothing is printed. The command line is built on the same functions.
+*/
+class Library {
+public:
+	//File bytes in memory.
+	static int ReadTarga(const std::vector<char>& bytes, Targa& image);
+	static int WriteTarga(const Targa& image, std::vector<char>& bytes);
+	static int ReadPreload(const std::vector<char>& bytes, IniPreload& preload);
+	static int WritePreload(IniPreload& preload, std::vector<char>& bytes);
+
+	//Frames picked by settings.frames or settings.range that exist in the preload, or all of them.
+	//Missing ones of frames go to skipped, the range is cut at the last frame.
+	static std::vector<int> SelectFrames(const ExportSettings& settings, int frames_amount, std::vector<int>* skipped = nullptr);
+	//Size of every exported frame (w, h) and the point all of them are aligned by (x, y).
+	static PreloadFrameData ExportSize(const ExportSettings& settings, const IniPreload& preload, const std::vector<int>& frame_ids);
+	//Draws one preload frame of the atlas into image, which has the export size. frame_y is the frame's y in atlas,
+	//in case it holds only some rows of the real atlas. 0 if the frame doesn't fit.
+	static int DrawFrame(const Targa& atlas, const PreloadFrameData& frame, int frame_y, bool bottom_to_top,
+		const PreloadFrameData& size, const ExportSettings& settings, Targa& image);
+	//Every selected frame of the atlas as an image of its own. Returns the amount of frames exported.
+	static int ExportFrames(const Targa& atlas, const IniPreload& preload, const ExportSettings& settings,
+		std::vector<Targa>& frames, std::vector<int>* frame_ids = nullptr);
+
+	//Trims the frames and packs them into one atlas with a preload per group, like --pack with --group.
+	//frames_amount and loop_mode are those of --frames and --loop. A PackJob with its inputs and outputs in memory.
+	//The frames' pixels are released.
+	static int PackFrames(std::vector<PackFrame>& frames, const PackSettings& settings, int preload_version,
+		int frames_amount, int loop_mode, Targa& atlas, std::vector<PackedPreload>& preloads);
+
+	//Like -c. 0 if the version is unknown.
+	static int ConvertPreload(IniPreload& preload, int version);
+};
+
+#endif // !Library_h_
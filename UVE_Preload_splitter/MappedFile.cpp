@@ -0,0 +1,157 @@
+#include "MappedFile.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <cerrno>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : view_(nullptr), size_(0), file_(INVALID_HANDLE_VALUE), mapping_(nullptr) {}
+#else
+MappedFile::MappedFile() : view_(nullptr), size_(0), file_(-1) {}
+#endif
+
+MappedFile::~MappedFile() {
+	// Not closed, so not finished: the file at path stays as it was.
+	Release();
+	if (!temp_.empty()) {
+		std::remove(temp_.c_str());
+	}
+}
+
+int MappedFile::Close() {
+	int result = Release();
+	if (temp_.empty()) {
+		return result;
+	}
+	if (result) {
+#ifdef _WIN32
+		result = MoveFileExA(temp_.c_str(), path_.c_str(), MOVEFILE_REPLACE_EXISTING) ? 1 : 0;
+#else
+		result = (std::rename(temp_.c_str(), path_.c_str()) == 0) ? 1 : 0;
+#endif
+	}
+	if (!result) {
+		std::remove(temp_.c_str());
+	}
+	temp_.clear();
+	path_.clear();
+	return result;
+}
+
+#ifdef _WIN32
+int MappedFile::Create(const std::string& path, size_t size) {
+	Close();
+	if (size == 0) {
+		return 0;
+	}
+	path_ = path;
+	temp_ = path + ".mapping";
+	file_ = CreateFileA(temp_.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE) {
+		temp_.clear();
+		return 0;
+	}
+	// The mapping grows the file to its size.
+	unsigned long long size64 = size;
+	mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xFFFFFFFF), nullptr);
+	if (!mapping_) {
+		Release();
+		std::remove(temp_.c_str());
+		temp_.clear();
+		return 0;
+	}
+	view_ = static_cast<unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_WRITE, 0, 0, size));
+	if (!view_) {
+		Release();
+		std::remove(temp_.c_str());
+		temp_.clear();
+		return 0;
+	}
+	size_ = size;
+	return 1;
+}
+
+int MappedFile::Release() {
+	int result = 1;
+	if (view_) {
+		result = FlushViewOfFile(view_, 0) ? 1 : 0;
+		UnmapViewOfFile(view_);
+		view_ = nullptr;
+	}
+	if (mapping_) {
+		CloseHandle(mapping_);
+		mapping_ = nullptr;
+	}
+	if (file_ != INVALID_HANDLE_VALUE) {
+		CloseHandle(file_);
+		file_ = INVALID_HANDLE_VALUE;
+	}
+	size_ = 0;
+	return result;
+}
+#else
+int MappedFile::Create(const std::string& path, size_t size) {
+	Close();
+	if (size == 0) {
+		return 0;
+	}
+	path_ = path;
+	temp_ = path + ".mapping";
+	file_ = open(temp_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (file_ < 0) {
+		temp_.clear();
+		return 0;
+	}
+	// The blocks are taken now: a full disk is an error here instead of SIGBUS in the middle of drawing.
+	int reserved = EOPNOTSUPP;
+#ifndef __APPLE__
+	reserved = posix_fallocate(file_, 0, static_cast<off_t>(size));
+#endif
+	if (reserved == EOPNOTSUPP || reserved == EINVAL) {
+		reserved = (ftruncate(file_, static_cast<off_t>(size)) == 0) ? 0 : errno;
+	}
+	void* view = reserved ? MAP_FAILED : mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file_, 0);
+	if (view == MAP_FAILED) {
+		Release();
+		std::remove(temp_.c_str());
+		temp_.clear();
+		return 0;
+	}
+	view_ = static_cast<unsigned char*>(view);
+	size_ = size;
+	return 1;
+}
+
+int MappedFile::Release() {
+	int result = 1;
+	if (view_) {
+		result = (munmap(view_, size_) == 0) ? 1 : 0;
+		view_ = nullptr;
+	}
+	if (file_ >= 0) {
+		if (close(file_) != 0) {
+			result = 0;
+		}
+		file_ = -1;
+	}
+	size_ = 0;
+	return result;
+}
+#endif
+
+unsigned char* MappedFile::GetView() const {
+	return view_;
+}
+
+size_t MappedFile::GetSize() const {
+	return size_;
+}
@@ -0,0 +1,42 @@
+#ifndef MappedFile_h_
+#define MappedFile_h_
+
+#include <string>
+
+/*
+A new file of a fixed size mapped to memory for writing.
+The file is zero filled, whatever is written to GetView() ends up in it when it's closed.
+It's made next to path and only replaces it in Close(), one dropped without Close() leaves path as it was.
+*/
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	//Creates the file aside, reserves its size on the disk and maps all of it.
+	int Create(const std::string& path, size_t size);
+	//Writes the file out and puts it at path.
+	int Close();
+
+	unsigned char* GetView() const;
+	size_t GetSize() const;
+
+private:
+	//Unmaps and closes the file, wherever it is.
+	int Release();
+
+	std::string path_;
+	std::string temp_; // Mapped, renamed to path_ by Close()
+	unsigned char* view_;
+	size_t size_;
+#ifdef _WIN32
+	void* file_;
+	void* mapping_;
+#else
+	int file_;
+#endif
+};
+
+#endif // !MappedFile_h_
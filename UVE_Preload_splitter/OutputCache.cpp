@@ -0,0 +1,200 @@
+#include "OutputCache.h"
+#include "Portability.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+const size_t OutputCache::DEFAULT_MAX_BYTES = size_t(2048) << 20;
+
+// Goes into every key. Change it when the same inputs and options start making different outputs.
+static const uint64_t CACHE_FORMAT = 1;
+static const char* CACHE_LIST = "files";
+static std::atomic<unsigned> cache_temp_id{ 0 };
+
+CacheKey::CacheKey() : hash_(0x9E3779B97F4A7C15ull) {
+	Mix(CACHE_FORMAT);
+}
+
+void CacheKey::Mix(uint64_t word) {
+	hash_ = (hash_ ^ word) * 0xFF51AFD7ED558CCDull;
+	hash_ ^= hash_ >> 32;
+}
+
+void CacheKey::Add(const void* bytes, size_t size) {
+	const unsigned char* data = static_cast<const unsigned char*>(bytes);
+	size_t words = size / 8;
+	for (size_t i = 0; i < words; ++i) {
+		uint64_t word = 0;
+		std::memcpy(&word, data + i * 8, 8);
+		Mix(word);
+	}
+	uint64_t tail = 0;
+	std::memcpy(&tail, data + words * 8, size - words * 8);
+	Mix(tail ^ (static_cast<uint64_t>(size) << 56));
+}
+
+void CacheKey::Add(int value) {
+	Mix(static_cast<uint64_t>(static_cast<int64_t>(value)));
+}
+
+void CacheKey::Add(const std::string& str) {
+	Add(str.data(), str.size());
+}
+
+int CacheKey::AddFile(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return 0;
+	}
+	// Chunks are a multiple of 8, so the words don't depend on where they end.
+	std::vector<char> chunk(size_t(1) << 20);
+	while (file) {
+		file.read(chunk.data(), chunk.size());
+		std::streamsize got = file.gcount();
+		if (got > 0) {
+			Add(chunk.data(), static_cast<size_t>(got));
+		}
+	}
+	return file.eof() ? 1 : 0;
+}
+
+uint64_t CacheKey::Get() const {
+	return hash_;
+}
+
+static std::string KeyName(uint64_t key) {
+	char name[20] = { 0 };
+	sprintf_s(name, "%016llx", static_cast<unsigned long long>(key));
+	return name;
+}
+
+OutputCache::OutputCache(const std::string& dir, size_t max_bytes, bool hardlinks) :
+	dir_(dir), max_bytes_(max_bytes), hardlinks_(hardlinks), bytes_(0), scanned_(false)
+{
+	std::error_code error{};
+	std::filesystem::create_directories(dir_, error);
+}
+
+int OutputCache::Restore(uint64_t key, const std::string& base) {
+	std::filesystem::path entry = std::filesystem::path(dir_) / KeyName(key);
+	std::ifstream list(entry / CACHE_LIST);
+	if (!list) {
+		return 0;
+	}
+	std::vector<std::string> files{};
+	std::string line{};
+	while (std::getline(list, line)) {
+		if (!line.empty()) {
+			files.push_back(line);
+		}
+	}
+	list.close();
+	std::error_code error{};
+	for (size_t i = 0; i < files.size(); ++i) {
+		std::filesystem::path target = std::filesystem::path(base) / files[i];
+		std::filesystem::path stored = entry / std::to_string(i);
+		std::filesystem::create_directories(target.parent_path(), error);
+		std::filesystem::remove(target, error);
+		error.clear();
+		if (hardlinks_) {
+			std::filesystem::create_hard_link(stored, target, error);
+		}
+		if (!hardlinks_ || error) {
+			error.clear();
+			std::filesystem::copy_file(stored, target, std::filesystem::copy_options::overwrite_existing, error);
+		}
+		if (error) {
+			return 0; // Evicted meanwhile, or the target can't be written. Made again by the caller.
+		}
+	}
+	// The list's time is when the entry was used last.
+	std::filesystem::last_write_time(entry / CACHE_LIST, std::filesystem::file_time_type::clock::now(), error);
+	return static_cast<int>(files.size());
+}
+
+void OutputCache::Store(uint64_t key, const std::string& base, const std::vector<std::string>& files) {
+	std::filesystem::path entry = std::filesystem::path(dir_) / KeyName(key);
+	std::filesystem::path temp = std::filesystem::path(dir_) / (KeyName(key) + ".tmp" + std::to_string(cache_temp_id++));
+	std::filesystem::path base_path = std::filesystem::absolute(base);
+	std::error_code error{};
+	std::filesystem::create_directories(temp, error);
+	std::string names{};
+	size_t bytes = 0;
+	for (size_t i = 0; i < files.size() && !error; ++i) {
+		std::filesystem::path file = std::filesystem::absolute(files[i], error);
+		names += file.lexically_relative(base_path).generic_string() + '\n';
+		std::filesystem::copy_file(file, temp / std::to_string(i), error);
+		bytes += static_cast<size_t>(std::filesystem::file_size(temp / std::to_string(i), error));
+	}
+	// The list goes last, a folder without one is still being written.
+	bool listed = false;
+	if (!error) {
+		std::ofstream list(temp / CACHE_LIST, std::ios::trunc);
+		list << names;
+		list.close();
+		listed = static_cast<bool>(list);
+	}
+	// Only whole entries get their name, so a reader never sees one being written.
+	if (listed) {
+		std::filesystem::rename(temp, entry, error);
+	}
+	std::filesystem::remove_all(temp, error);
+	if (!error) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		bytes_ += bytes;
+		// The folder is only looked through when it may be over the limit, other processes add to it too.
+		if (!scanned_ || bytes_ > max_bytes_) {
+			Evict();
+		}
+	}
+}
+
+void OutputCache::Unshare(const std::string& path) {
+	std::error_code error{};
+	if (std::filesystem::hard_link_count(path, error) > 1 && !error) {
+		std::filesystem::remove(path, error);
+	}
+}
+
+// Under mutex_.
+void OutputCache::Evict() {
+	scanned_ = true;
+	struct CacheEntry {
+		std::filesystem::path path{};
+		std::filesystem::file_time_type used{};
+		size_t bytes{ 0 };
+	};
+	std::vector<CacheEntry> entries{};
+	size_t total = 0;
+	std::error_code error{};
+	for (std::filesystem::directory_iterator it(dir_, error), end; !error && it != end; it.increment(error)) {
+		std::error_code entry_error{};
+		std::filesystem::path list = it->path() / CACHE_LIST;
+		if (it->path().filename().string().find(".tmp") != std::string::npos || !std::filesystem::is_regular_file(list, entry_error)) {
+			continue; // Being written
+		}
+		CacheEntry entry{ it->path(), std::filesystem::last_write_time(list, entry_error), 0 };
+		for (std::filesystem::directory_iterator file(it->path(), entry_error), files_end; !entry_error && file != files_end; file.increment(entry_error)) {
+			entry.bytes += static_cast<size_t>(file->file_size(entry_error));
+		}
+		total += entry.bytes;
+		entries.push_back(entry);
+	}
+	bytes_ = total;
+	if (total <= max_bytes_) {
+		return;
+	}
+	std::sort(entries.begin(), entries.end(), [](const CacheEntry& a, const CacheEntry& b) { return a.used < b.used; });
+	for (const CacheEntry& entry : entries) {
+		if (total <= max_bytes_) {
+			break;
+		}
+		std::filesystem::remove_all(entry.path, error);
+		total -= entry.bytes;
+	}
+	bytes_ = total;
+}
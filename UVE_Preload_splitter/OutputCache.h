@@ -0,0 +1,55 @@
+#ifndef OutputCache_h_
+#define OutputCache_h_
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+// Fast 64 bit hash of everything an output is made from: input bytes, names and options.
+class CacheKey {
+public:
+	CacheKey();
+	void Add(const void* bytes, size_t size);
+	void Add(int value);
+	void Add(const std::string& str);
+	//0 if the file can't be read.
+	int AddFile(const std::string& path);
+	uint64_t Get() const;
+
+private:
+	void Mix(uint64_t word);
+
+	uint64_t hash_;
+};
+
+/*
+--cache: outputs of pack jobs and exports, kept in a folder by the key of what made them.
+An entry is a folder named after the key with a copy of every output and the list of their paths relative to the job.
+The least recently used entries are dropped when the folder grows over its size. Several processes may share it.
+*/
+class OutputCache {
+public:
+	OutputCache(const std::string& dir, size_t max_bytes, bool hardlinks);
+	//Puts the files stored under key back, relative to base. Returns the amount of files, 0 if there is no such entry.
+	int Restore(uint64_t key, const std::string& base);
+	//Keeps copies of files (paths relative to base) under key.
+	void Store(uint64_t key, const std::string& base, const std::vector<std::string>& files);
+	//Unlinks path if it's a hard link (restored with --cache-hardlinks), so rewriting it doesn't rewrite the cached copy.
+	//Whatever opens an output for writing calls it first.
+	static void Unshare(const std::string& path);
+
+	static const size_t DEFAULT_MAX_BYTES;
+
+private:
+	void Evict();
+
+	std::string dir_;
+	size_t max_bytes_;
+	bool hardlinks_;
+	size_t bytes_; // In the folder, as far as this process knows
+	bool scanned_;
+	std::mutex mutex_;
+};
+
+#endif // !OutputCache_h_
@@ -0,0 +1,418 @@
+#include "PackJob.h"
+#include "Bundle.h"
+#include "IniPreload.h"
+#include "Parallel.h"
+#include "Profile.h"
+#include "PixelPool.h"
+#include "Debug.h"
+#include "Portability.h"
+#include <cmath>
+#include <filesystem>
+#include <new>
+#include <chrono>
+
+void PackSettings::Apply(Atlas& atlas) const {
+	atlas.SetPadding(padding);
+	atlas.SetColourPadding(colour_padding);
+	atlas.SetPowerOfTwo(power_of_two);
+	atlas.SetMappedOutput(mapped_output);
+	atlas.debug_show_transparency = debug_show_transparency;
+	atlas.debug_middle_point = debug_middle_point;
+	atlas.debug_show_frame = debug_show_frame;
+}
+
+std::string AtlasPath(const std::string& source) {
+	std::string path = source;
+	if (Bundle::IsBundlePath(path)) {
+		path = path.substr(0, path.rfind('.')) + ".tga";
+	}
+	size_t name_start = path.find_last_of("\\/") + 1;
+	return path.substr(0, name_start) + "atl_" + path.substr(name_start);
+}
+
+PackJob::PackJob() {}
+
+int PackJob::LoadInput(const PackInput& input, std::vector<AtlasEntry>& images) {
+	if (input.image) {
+		images.resize(1);
+		images[0].image = std::move(*input.image);
+		return 1;
+	}
+	if (Bundle::IsBundlePath(input.tga)) {
+		Bundle bundle{};
+		if (!bundle.Open(input.tga)) {
+			return 0;
+		}
+		images.resize(bundle.frames.size());
+		for (size_t j = 0; j < bundle.frames.size(); ++j) {
+			if (!bundle.GetFrame(j, images[j].image)) {
+				return 0;
+			}
+		}
+		bundle.Close();
+		return 1;
+	}
+	//Open the image
+	images.resize(1);
+	return images[0].image.Open(input.tga);
+}
+
+int PackJob::LoadTrimmed(const PackInput& input, const TrimRecord& record, std::vector<AtlasEntry>& images) {
+	images.resize(1);
+	AtlasEntry& entry = images[0];
+	// TrimEntry() counts y from the top, the rows are stored from the bottom.
+	if (!entry.image.OpenRows(input.tga, record.image_h - record.data_start.y - record.rect.h, record.rect.h)) {
+		return 0;
+	}
+	if (entry.image.w != record.image_w) {
+		return 0;
+	}
+	entry.rect = record.rect;
+	entry.offset = record.offset;
+	entry.data_start = { record.data_start.x, 0 };
+	return 1;
+}
+
+// What loading the input takes before it's cropped. Bundles hold uncompressed TGAs, so the file size is close enough.
+size_t PackJob::InputSize(const PackInput& input) {
+	if (input.image) {
+		return input.image->PixelsSize();
+	}
+	if (Bundle::IsBundlePath(input.tga)) {
+		std::error_code error{};
+		size_t size = static_cast<size_t>(std::filesystem::file_size(input.tga, error));
+		return error ? 0 : size;
+	}
+	Targa header{};
+	if (!header.OpenHeader(input.tga)) {
+		return 0;
+	}
+	return static_cast<size_t>(header.w) * header.h * (header.colour_depth >> 3);
+}
+
+// Input names go in as well, preloads are named after them.
+int PackJob::CacheKeyOf(CacheKey& key, const std::string& base) {
+	std::error_code error{};
+	std::filesystem::path base_path = std::filesystem::absolute(base, error);
+	for (const PackInput& input : inputs) {
+		key.Add(std::filesystem::absolute(input.tga, error).lexically_relative(base_path).generic_string());
+		if (!key.AddFile(input.tga)) {
+			return 0;
+		}
+		key.Add(input.group);
+		key.Add(input.frames);
+		key.Add(input.loop);
+		key.Add(input.preload_version);
+	}
+	key.Add(settings.padding);
+	key.Add(settings.colour_padding);
+	key.Add(settings.power_of_two);
+	key.Add(settings.greyscale);
+	key.Add(settings.debug_show_transparency);
+	key.Add(settings.debug_middle_point);
+	key.Add(settings.debug_show_frame);
+	key.Add(settings.output.empty() ? std::string() : std::filesystem::absolute(settings.output, error).lexically_relative(base_path).generic_string());
+	return error ? 0 : 1;
+}
+
+int PackJob::Run() {
+	entries_.clear();
+	groups_.clear();
+	outputs_.clear();
+	if (inputs.empty()) {
+		return 0;
+	}
+
+	uint64_t cache_key = 0;
+	std::string cache_base = std::filesystem::path(inputs[0].tga).parent_path().string();
+	if (cache_base.empty()) {
+		cache_base = ".";
+	}
+	if (cache) {
+		CacheKey key{};
+		if (CacheKeyOf(key, cache_base)) {
+			cache_key = key.Get();
+			int restored = cache->Restore(cache_key, cache_base);
+			// The atlas and a preload per group.
+			if (restored) {
+				Print("Job %d: the atlas and %d preloads are taken from the cache.\n", id, restored - 1);
+				ok += restored - 1;
+				return 1;
+			}
+		}
+	}
+
+	/* Inputs are read and trimmed ahead on worker threads. They are taken in order here, so the atlas doesn't depend on the timing.
+	Only the trimmed pixels are kept, the rest of the source is freed before the next input is read. */
+	std::vector<std::vector<AtlasEntry>> loaded(inputs.size());
+	std::vector<int> loaded_ok(inputs.size(), 0);
+	MemoryBudget budget(settings.max_memory);
+	bool over_budget = false;
+	int memory_job = PixelPool::NewJob();
+	PixelScope memory_scope(PIXCAT_OTHER, memory_job);
+	auto load = [&](int i) {
+		PixelScope input_scope(PIXCAT_SOURCE, memory_job);
+		size_t reserved = settings.max_memory ? InputSize(inputs[i]) : 0;
+		size_t kept = 0;
+		budget.Reserve(reserved);
+		try {
+			// Bundles hold many frames and are never in the sidecar, nor are images in memory.
+			bool single = !Bundle::IsBundlePath(inputs[i].tga) && !inputs[i].image;
+			TrimRecord record{};
+			FileStamp stamp{};
+			if (frames && frames->Find(inputs[i].tga, settings.greyscale, stamp, loaded[i])) {
+				loaded_ok[i] = 1;
+				for (const AtlasEntry& atl_entry : loaded[i]) {
+					kept += atl_entry.image.PixelsSize();
+				}
+			}
+			else if (sidecar && single && sidecar->Find(inputs[i].tga, stamp, record) && LoadTrimmed(inputs[i], record, loaded[i])) {
+				loaded_ok[i] = 1;
+				kept += Atlas::CropEntry(loaded[i][0], settings.greyscale);
+			}
+			else {
+				loaded[i].clear();
+				loaded_ok[i] = LoadInput(inputs[i], loaded[i]);
+				if (loaded_ok[i]) {
+					ProfileScope profile(PROFSTAGE_TRIM, &inputs[i].tga);
+					for (AtlasEntry& atl_entry : loaded[i]) {
+						Atlas::TrimEntry(atl_entry);
+						if (sidecar && single) {
+							sidecar->Set(inputs[i].tga, stamp, atl_entry);
+						}
+						kept += Atlas::CropEntry(atl_entry, settings.greyscale);
+					}
+				}
+			}
+			if (frames && loaded_ok[i] == 1) {
+				frames->Set(inputs[i].tga, settings.greyscale, stamp, loaded[i]);
+			}
+		}
+		catch (const std::bad_alloc&) {
+			loaded[i].clear();
+			loaded_ok[i] = -1;
+		}
+		budget.Finish(reserved, settings.max_memory ? kept : 0);
+	};
+	auto collect = [&](int i) {
+		const PackInput& input = inputs[i];
+		std::vector<AtlasEntry> new_entries = std::move(loaded[i]);
+		if (loaded_ok[i] < 0) {
+			Print("Job %d: out of memory when reading %s.\n", id, input.tga.c_str());
+			++err;
+			return false;
+		}
+		if (!loaded_ok[i]) {
+			Print("Job %d: could not read %s.\n", id, input.tga.c_str());
+			++err;
+			return false;
+		}
+
+		if (groups_.empty() || groups_.back().group != input.group) {
+			AtlasAnimation group{};
+			group.tga = input.tga;
+			group.first = entries_.size();
+			group.group = input.group;
+			groups_.push_back(group);
+		}
+		AtlasAnimation& group = groups_.back();
+		group.count += new_entries.size();
+		group.frames_amount = input.frames;
+		group.loop_mode = input.loop;
+		group.preload_version = input.preload_version;
+
+		for (AtlasEntry& atl_entry : new_entries) {
+			Print("Atlas entry\nWxH: %dx%d\nOffsets (rounded): %.2f (%d), %.2f (%d)\nColour margin: %d\nMargin: %d\n",
+				atl_entry.rect.w,
+				atl_entry.rect.h,
+				atl_entry.offset.x, static_cast<int>(std::floor(atl_entry.offset.x + 0.5f)),
+				atl_entry.offset.y, static_cast<int>(std::floor(atl_entry.offset.y + 0.5f)),
+				settings.colour_padding,
+				settings.padding
+				);
+			DEBUG_PRINTVAL(atl_entry.data_start.x, "%d");
+			DEBUG_PRINTVAL(atl_entry.data_start.y, "%d")
+
+			entries_.push_back(std::move(atl_entry));
+		}
+		if (settings.max_memory && !over_budget && budget.Used() > settings.max_memory) {
+			Print("Job %d: the trimmed frames alone take more than --max-memory, inputs are read one by one now.\n", id);
+			over_budget = true;
+		}
+		return true;
+	};
+	int threads = ThreadsAmount(settings.threads);
+	int result = OrderedPipeline(static_cast<int>(inputs.size()), threads, threads * 2, load, collect) && !entries_.empty();
+	if (result) {
+		Atlas atlas;
+		settings.Apply(atlas);
+		try {
+			result = Save(atlas);
+		}
+		catch (const std::bad_alloc&) {
+			Print("Job %d: out of memory when making the atlas.\n", id);
+			++err;
+			result = 0;
+		}
+	}
+	entries_.clear();
+	entries_.shrink_to_fit();
+	loaded.clear();
+	peak_memory = PixelPool::JobPeak(memory_job);
+	if (result && cache_key) {
+		cache->Store(cache_key, cache_base, outputs_);
+	}
+	return result;
+}
+
+int PackJob::Plan(const PlanSettings& plan) {
+	std::vector<AtlasEntry> entries{};
+	std::vector<std::string> names{};
+	int trimmed = 0, untrimmed = 0, bundled = 0;
+	for (const PackInput& input : inputs) {
+		if (Bundle::IsBundlePath(input.tga)) {
+			// Bundle frames are counted as big as they were exported, the pack still trims them.
+			Bundle bundle{};
+			if (!bundle.Open(input.tga)) {
+				printf_s("Job %d: could not read %s.\n", id, input.tga.c_str());
+				++err;
+				return 0;
+			}
+			for (size_t j = 0; j < bundle.frames.size(); ++j) {
+				AtlasEntry entry{};
+				entry.image.colour_depth = settings.greyscale ? 8 : 32;
+				entry.rect = { 0, 0, bundle.frames[j].frame.w, bundle.frames[j].frame.h };
+				entries.push_back(entry);
+				names.push_back(input.tga + "#" + std::to_string(j));
+				++bundled;
+			}
+			bundle.Close();
+			continue;
+		}
+		AtlasEntry entry{};
+		TrimRecord record{};
+		FileStamp stamp{};
+		if (sidecar && sidecar->Find(input.tga, stamp, record)) {
+			entry.rect = record.rect;
+			entry.image.colour_depth = 32;
+			++trimmed;
+		}
+		if (!entry.image.OpenHeader(input.tga)) {
+			printf_s("Job %d: could not read %s.\n", id, input.tga.c_str());
+			++err;
+			return 0;
+		}
+		if (entry.rect.w == 0) {
+			entry.rect = { 0, 0, entry.image.w, entry.image.h };
+			++untrimmed;
+		}
+		if (settings.greyscale) {
+			entry.image.colour_depth = 8;
+		}
+		entries.push_back(entry);
+		names.push_back(input.tga);
+	}
+	if (entries.empty()) {
+		return 0;
+	}
+	long long frames_area = 0;
+	for (const AtlasEntry& entry : entries) {
+		frames_area += static_cast<long long>(entry.rect.w) * entry.rect.h;
+	}
+	printf_s("Job %d plan: %zu frames, %d trimmed sizes, %d untrimmed (no sidecar record, the whole image is counted), %d from bundles (their exported size).\n",
+		id, entries.size(), trimmed, untrimmed, bundled);
+
+	std::vector<int> paddings = plan.padding.empty() ? std::vector<int>{ settings.padding } : plan.padding;
+	std::vector<int> colour_paddings = plan.colour_padding.empty() ? std::vector<int>{ settings.colour_padding } : plan.colour_padding;
+	std::vector<int> powers = plan.power_of_two.empty() ? std::vector<int>{ settings.power_of_two } : plan.power_of_two;
+	printf_s("%8s %15s %13s %12s %8s %10s\n", "Padding", "Colour padding", "Power of two", "Atlas", "Fill", "Time ms");
+	bool first = true;
+	for (int power : powers) {
+		for (int padding : paddings) {
+			for (int colour_padding : colour_paddings) {
+				PackSettings variant = settings;
+				variant.padding = padding;
+				variant.colour_padding = colour_padding;
+				variant.power_of_two = power != 0;
+				Atlas atlas;
+				variant.Apply(atlas);
+				std::vector<AtlasEntry> placed = entries;
+				auto start = std::chrono::steady_clock::now();
+				int packed = atlas.CreateAtlas(placed);
+				double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				if (packed == -1) {
+					printf_s("%8d %15d %13s %12s %8s %10.2f\n", padding, colour_padding, power ? "yes" : "no", "too big", "", ms);
+					continue;
+				}
+				char size[24] = { 0 };
+				sprintf_s(size, "%dx%d", atlas.size_.x, atlas.size_.y);
+				printf_s("%8d %15d %13s %12s %7.1f%% %10.2f\n", padding, colour_padding, power ? "yes" : "no", size,
+					100.0 * frames_area / (static_cast<double>(atlas.size_.x) * atlas.size_.y), ms);
+				// Where every frame goes, for the first combination only.
+				if (first) {
+					for (size_t j = 0; j < placed.size(); ++j) {
+						printf_s("\t%dx%d at (%d, %d) %s\n", placed[j].rect.w, placed[j].rect.h, placed[j].rect.x, placed[j].rect.y, names[j].c_str());
+					}
+					first = false;
+				}
+			}
+		}
+	}
+	++ok;
+	return 1;
+}
+
+int PackJob::Save(Atlas& atlas) {
+	bool flipped = (groups_[0].preload_version == IniPreload::VERSION_FLOAT);
+	for (const AtlasAnimation& group : groups_) {
+		if ((group.preload_version == IniPreload::VERSION_FLOAT) != flipped) {
+			Print("Float preloads can't share an atlas with int or ini ones (%s).\n", group.tga.c_str());
+			++err;
+			return 0;
+		}
+	}
+
+	std::string atlas_path = settings.output.empty() ? AtlasPath(groups_[0].tga) : settings.output;
+	if (atlas.CreateAtlas(entries_) == -1) {
+		Print("Could not create an image atlas.\n");
+		++err;
+		return 0;
+	}
+	if (atlas_image) {
+		if (atlas.MakeImage(*atlas_image, entries_, groups_[0].preload_version, settings.greyscale) == -1) {
+			++err;
+			return 0;
+		}
+	}
+	else if (atlas.SaveImage(atlas_path, entries_, groups_[0].preload_version, settings.greyscale) == -1) {
+		Print("An error occurred when trying to read/write %s.\n", atlas_path.c_str());
+		++err;
+		return 0;
+	}
+	else {
+		outputs_.push_back(atlas_path);
+	}
+	for (size_t i = 0; i < groups_.size(); ++i) {
+		const AtlasAnimation& group = groups_[i];
+		if (preloads) {
+			preloads->push_back({ group.group, IniPreload{} });
+			if (atlas.MakePreload(preloads->back().preload, entries_, group.first, group.count, group.frames_amount, group.loop_mode, group.preload_version) != -1) {
+				++ok;
+			}
+			else {
+				++err;
+			}
+			continue;
+		}
+		std::string preload_path = ((i == 0) ? atlas_path : AtlasPath(group.tga)) + Atlas::PreloadExtension(group.preload_version);
+		if (atlas.SavePreload(preload_path, entries_, group.first, group.count, group.frames_amount, group.loop_mode, group.preload_version) != -1) {
+			outputs_.push_back(preload_path);
+			++ok;
+		}
+		else {
+			Print("An error occurred when trying to read/write %s.\n", preload_path.c_str());
+			++err;
+		}
+	}
+	return err ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+#ifndef PackJob_h_
+#define PackJob_h_
+
+#include <string>
+#include <vector>
+#include "AtlasPack.h"
+#include "IniPreload.h"
+#include "OutputCache.h"
+#include "TrimSidecar.h"
+#include "FrameCache.h"
+#include "Portability.h"
+
+struct PackSettings {
+	int padding{ 0 };
+	int colour_padding{ 2 };
+	bool power_of_two{ true };
+	bool greyscale{ false };
+	bool debug_show_transparency{ false };
+	bool debug_middle_point{ false };
+	bool debug_show_frame{ false };
+	std::string output{}; // atl_[first file] if empty
+	int threads{ 0 }; // Input loading threads, 0 - one per core
+	size_t max_memory{ 0 }; // Bytes of input pixels held at once, 0 - no limit
+	bool mapped_output{ false };
+
+	void Apply(Atlas& atlas) const;
+};
+
+struct PackInput {
+	std::string tga{}; // A TGA frame or a .tgab bundle
+	Targa* image{ nullptr }; // In memory instead of tga, moved out when it's loaded
+	int group{ 0 };
+	int frames{ -1 };
+	int loop{ PACKFLAG_REPEAT_LAST_FRAME };
+	int preload_version{ 0 };
+};
+
+// --plan: the setting combinations to try. An empty list keeps the job's own setting.
+struct PlanSettings {
+	std::vector<int> padding{};
+	std::vector<int> colour_padding{};
+	std::vector<int> power_of_two{};
+};
+
+// Frames of one animation (pack group or --merge pair) inside a shared atlas.
+struct AtlasAnimation {
+	std::string tga{};
+	size_t first{ 0 }, count{ 0 };
+	int group{ 0 };
+	int frames_amount{ -1 };
+	int loop_mode{ PACKFLAG_REPEAT_LAST_FRAME };
+	int preload_version{ 0 };
+};
+
+// One preload of an atlas made in memory.
+struct PackedPreload {
+	int group{ 0 };
+	IniPreload preload{};
+};
+
+// One atlas with its preloads. Jobs share nothing, so they can run at the same time.
+class PackJob {
+public:
+	PackJob();
+	int Run();
+	//Lays the atlas out for every combination of settings without reading any pixels and prints the results.
+	//Frame sizes come from the trim sidecar, bundle indices or TGA headers (untrimmed).
+	int Plan(const PlanSettings& plan);
+
+	int id{ 0 };
+	std::vector<PackInput> inputs{};
+	PackSettings settings{};
+	// Preloads saved and errors met, added to gCntOk/gCntErr by the caller.
+	int ok{ 0 }, err{ 0 };
+	// Most pixel buffer bytes the job had at once.
+	size_t peak_memory{ 0 };
+	// --cache, none if null. Shared with other jobs.
+	OutputCache* cache{ nullptr };
+	// --trim-sidecar, none if null. Shared with other jobs.
+	TrimSidecar* sidecar{ nullptr };
+	// --watch, none if null. Cropped inputs of earlier runs, shared with other jobs.
+	FrameCache* frames{ nullptr };
+	// Library::PackFrames: the atlas and a preload per group are made here instead of saved when set.
+	Targa* atlas_image{ nullptr };
+	std::vector<PackedPreload>* preloads{ nullptr };
+	// Nothing printed.
+	bool quiet{ false };
+
+private:
+	template <class... Args>
+	void Print(const char* format, Args... args) const {
+		if (!quiet) {
+			printf_s(format, args...);
+		}
+	}
+
+	int LoadInput(const PackInput& input, std::vector<AtlasEntry>& images);
+	//Reads only the rows a TGA input was trimmed to before. The entry is ready for CropEntry().
+	int LoadTrimmed(const PackInput& input, const TrimRecord& record, std::vector<AtlasEntry>& images);
+	size_t InputSize(const PackInput& input);
+	int Save(Atlas& atlas);
+	//Everything the atlas and preloads are made from. 0 if an input can't be read.
+	int CacheKeyOf(CacheKey& key, const std::string& base);
+
+	// Files Save() wrote, for the cache.
+	std::vector<std::string> outputs_{};
+
+	std::vector<AtlasEntry> entries_{};
+	std::vector<AtlasAnimation> groups_{};
+};
+
+// atl_ in front of the file name, next to the source. Bundles become .tga.
+std::string AtlasPath(const std::string& source);
+
+#endif // !PackJob_h_
@@ -0,0 +1,123 @@
+#include "Parallel.h"
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+int ThreadsAmount(int threads) {
+	if (threads > 0) {
+		return threads;
+	}
+	return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+void ParallelFor(int count, int threads, const std::function<void(int)>& fn) {
+	threads = std::min(ThreadsAmount(threads), count);
+	if (threads <= 1) {
+		for (int i = 0; i < count; ++i) {
+			fn(i);
+		}
+		return;
+	}
+
+	std::atomic<int> next{ 0 };
+	auto worker = [&]() {
+		for (int i = next++; i < count; i = next++) {
+			fn(i);
+		}
+	};
+	std::vector<std::thread> pool{};
+	for (int i = 1; i < threads; ++i) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& t : pool) {
+		t.join();
+	}
+}
+
+bool OrderedPipeline(int count, int threads, int ahead,
+	const std::function<void(int)>& produce, const std::function<bool(int)>& consume) {
+	int workers = std::min(ThreadsAmount(threads), count);
+	if (workers <= 1) {
+		for (int i = 0; i < count; ++i) {
+			produce(i);
+			if (!consume(i)) {
+				return false;
+			}
+		}
+		return true;
+	}
+	ahead = std::max(ahead, workers);
+
+	std::mutex mutex{};
+	std::condition_variable cv{};
+	std::vector<char> done(count, 0);
+	int next = 0, consumed = 0;
+	bool stop = false;
+	auto worker = [&]() {
+		for (;;) {
+			int i = 0;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [&]() { return stop || next >= count || next < consumed + ahead; });
+				if (stop || next >= count) {
+					return;
+				}
+				i = next++;
+			}
+			produce(i);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				done[i] = 1;
+			}
+			cv.notify_all();
+		}
+	};
+	std::vector<std::thread> pool{};
+	for (int i = 0; i < workers; ++i) {
+		pool.emplace_back(worker);
+	}
+
+	bool result = true;
+	for (int i = 0; i < count && result; ++i) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&]() { return done[i] != 0; });
+		}
+		result = consume(i);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			consumed = i + 1;
+			stop = !result;
+		}
+		cv.notify_all();
+	}
+	for (std::thread& t : pool) {
+		t.join();
+	}
+	return result;
+}
+
+MemoryBudget::MemoryBudget(size_t limit) : limit_(limit), used_(0), loading_(0) {}
+
+void MemoryBudget::Reserve(size_t bytes) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	cv_.wait(lock, [&]() { return limit_ == 0 || loading_ == 0 || used_ + bytes <= limit_; });
+	used_ += bytes;
+	++loading_;
+}
+
+void MemoryBudget::Finish(size_t reserved, size_t kept) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		used_ = used_ - reserved + kept;
+		--loading_;
+	}
+	cv_.notify_all();
+}
+
+size_t MemoryBudget::Used() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return used_;
+}
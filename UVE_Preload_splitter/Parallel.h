@@ -0,0 +1,36 @@
+#ifndef Parallel_h_
+#define Parallel_h_
+
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+//0 - one thread per core.
+int ThreadsAmount(int threads);
+//Calls fn(0) ... fn(count - 1) on up to `threads` threads. The calling thread takes part too.
+void ParallelFor(int count, int threads, const std::function<void(int)>& fn);
+/* Calls produce(i) on up to `threads` worker threads, at most `ahead` items in front of the one consumed,
+and consume(0) ... consume(count - 1) in order on the calling thread. consume returning false stops the rest.
+Returns false if it was stopped. */
+bool OrderedPipeline(int count, int threads, int ahead,
+	const std::function<void(int)>& produce, const std::function<bool(int)>& consume);
+
+/* Bytes that may be held at once by threads loading data. Reserve() waits until the bytes fit,
+unless nothing else is loading (so one item bigger than the limit still goes through).
+Finish() gives back what wasn't kept, kept bytes stay counted. 0 - no limit. */
+class MemoryBudget {
+public:
+	explicit MemoryBudget(size_t limit);
+	void Reserve(size_t bytes);
+	void Finish(size_t reserved, size_t kept);
+	size_t Used();
+
+private:
+	size_t limit_;
+	size_t used_;
+	int loading_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+};
+
+#endif // !Parallel_h_
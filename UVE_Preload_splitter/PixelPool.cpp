@@ -0,0 +1,201 @@
+#include "PixelPool.h"
+#include "Portability.h"
+#include <map>
+#include <mutex>
+#include <new>
+#include <atomic>
+#include <cstdio>
+#include <algorithm>
+
+// Sits in front of every block, ALIGNMENT bytes so the pixels stay aligned.
+struct BlockHeader {
+	size_t size;
+	int category;
+	int job;
+};
+
+struct JobMemory {
+	size_t live{ 0 };
+	size_t peak{ 0 };
+	bool read{ false }; // JobPeak() was called, dropped once nothing is left in use
+};
+
+static const char* CategoryNames[PIXCATS_AMOUNT] = { "other", "sources", "atlas", "regions", "export" };
+
+static std::mutex pool_mutex{};
+static std::map<size_t, std::vector<void*>> pool_blocks{}; // Class size -> free blocks
+static std::map<int, JobMemory> pool_jobs{};
+static PixelPool::Stats pool_stats{};
+static size_t pool_cache_limit = size_t(256) << 20;
+static size_t pool_limit = 0;
+static std::atomic<int> pool_next_job{ 0 };
+static thread_local int tl_category = PIXCAT_OTHER;
+static thread_local int tl_job = PIXJOB_NONE;
+
+// 64, 128, 192, 256, 320, ... 512, 640, ... Wastes a quarter at most.
+static size_t ClassSize(size_t bytes) {
+	size_t size = PixelPool::ALIGNMENT;
+	size_t power = PixelPool::ALIGNMENT;
+	while (size < bytes) {
+		if (size >= power * 2) {
+			power *= 2;
+		}
+		size += std::max(PixelPool::ALIGNMENT, power / 4);
+	}
+	return size;
+}
+
+// Under pool_mutex.
+static void CountBlock(const BlockHeader& header, bool add) {
+	size_t& category_live = pool_stats.category_live[header.category];
+	if (add) {
+		pool_stats.live_bytes += header.size;
+		pool_stats.peak_bytes = std::max(pool_stats.peak_bytes, pool_stats.live_bytes);
+		category_live += header.size;
+		pool_stats.category_peak[header.category] = std::max(pool_stats.category_peak[header.category], category_live);
+	}
+	else {
+		pool_stats.live_bytes -= header.size;
+		category_live -= header.size;
+	}
+	if (header.job >= 0) {
+		auto found = pool_jobs.try_emplace(header.job).first;
+		JobMemory& job = found->second;
+		if (add) {
+			job.live += header.size;
+			job.peak = std::max(job.peak, job.live);
+		}
+		else {
+			job.live -= header.size;
+			if (!job.live && job.read) {
+				pool_jobs.erase(found);
+			}
+		}
+	}
+}
+
+void* PixelPool::Allocate(size_t bytes) {
+	size_t size = ClassSize(bytes + ALIGNMENT);
+	BlockHeader header{ size, tl_category, tl_job };
+	void* block = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		if (pool_limit && pool_stats.live_bytes + size > pool_limit) {
+			printf_s("Pixel memory limit (%zu MB) reached: %zu KB more needed for %s.\nIn use:", pool_limit >> 20, size >> 10, CategoryNames[tl_category]);
+			for (int i = 0; i < PIXCATS_AMOUNT; ++i) {
+				printf_s(" %s %zu KB%s", CategoryNames[i], pool_stats.category_live[i] >> 10, (i + 1 < PIXCATS_AMOUNT) ? "," : ".\n");
+			}
+			throw std::bad_alloc();
+		}
+		CountBlock(header, true);
+		auto found = pool_blocks.find(size);
+		if (found != pool_blocks.end() && !found->second.empty()) {
+			block = found->second.back();
+			found->second.pop_back();
+			pool_stats.cached_bytes -= size;
+			++pool_stats.reused;
+		}
+		else {
+			++pool_stats.allocations;
+		}
+	}
+	if (!block) {
+		try {
+			block = ::operator new(size, std::align_val_t(ALIGNMENT));
+		}
+		catch (const std::bad_alloc&) {
+			std::lock_guard<std::mutex> lock(pool_mutex);
+			CountBlock(header, false);
+			throw;
+		}
+	}
+	*static_cast<BlockHeader*>(block) = header;
+	return static_cast<unsigned char*>(block) + ALIGNMENT;
+}
+
+// The size is taken from the header, the allocator's one is left out.
+void PixelPool::Free(void* pixels, size_t) {
+	if (!pixels) {
+		return;
+	}
+	void* block = static_cast<unsigned char*>(pixels) - ALIGNMENT;
+	BlockHeader header = *static_cast<BlockHeader*>(block);
+	{
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		CountBlock(header, false);
+		if (pool_stats.cached_bytes + header.size <= pool_cache_limit) {
+			pool_blocks[header.size].push_back(block);
+			pool_stats.cached_bytes += header.size;
+			return;
+		}
+	}
+	::operator delete(block, std::align_val_t(ALIGNMENT));
+}
+
+void PixelPool::SetCacheLimit(size_t bytes) {
+	{
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		pool_cache_limit = bytes;
+	}
+	Trim();
+}
+
+void PixelPool::SetLimit(size_t bytes) {
+	std::lock_guard<std::mutex> lock(pool_mutex);
+	pool_limit = bytes;
+}
+
+void PixelPool::Trim() {
+	std::map<size_t, std::vector<void*>> blocks{};
+	{
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		blocks.swap(pool_blocks);
+		pool_stats.cached_bytes = 0;
+	}
+	for (auto& size_blocks : blocks) {
+		for (void* block : size_blocks.second) {
+			::operator delete(block, std::align_val_t(ALIGNMENT));
+		}
+	}
+}
+
+PixelPool::Stats PixelPool::GetStats() {
+	std::lock_guard<std::mutex> lock(pool_mutex);
+	return pool_stats;
+}
+
+int PixelPool::NewJob() {
+	return pool_next_job++;
+}
+
+size_t PixelPool::JobPeak(int job) {
+	std::lock_guard<std::mutex> lock(pool_mutex);
+	auto found = pool_jobs.find(job);
+	if (found == pool_jobs.end()) {
+		return 0;
+	}
+	size_t peak = found->second.peak;
+	if (found->second.live) {
+		found->second.read = true;
+	}
+	else {
+		pool_jobs.erase(found);
+	}
+	return peak;
+}
+
+const char* PixelPool::CategoryName(int category) {
+	return CategoryNames[category];
+}
+
+PixelScope::PixelScope(int category, int job) : category_(tl_category), job_(tl_job) {
+	tl_category = category;
+	if (job != PIXJOB_INHERIT) {
+		tl_job = job;
+	}
+}
+
+PixelScope::~PixelScope() {
+	tl_category = category_;
+	tl_job = job_;
+}
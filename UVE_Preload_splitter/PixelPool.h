@@ -0,0 +1,90 @@
+#ifndef PixelPool_h_
+#define PixelPool_h_
+
+#include <cstddef>
+#include <vector>
+
+// What a pixel buffer is used for, see PixelScope.
+enum PixelCategories {
+	PIXCAT_OTHER,
+	PIXCAT_SOURCE, // Opened images and pack entries
+	PIXCAT_ATLAS,
+	PIXCAT_REGION, // GetRegion() results
+	PIXCAT_EXPORT, // Exported frames and sprite sheet cells
+	PIXCATS_AMOUNT
+};
+
+/*
+Pixel buffers are made and dropped for every frame and region. Freed blocks are kept by size class
+(64 bytes aligned, four classes per power of two) and given out again instead of going back to the system.
+Every block also remembers its category and job, so the bytes in use are known for both.
+Shared by all threads.
+*/
+class PixelPool {
+public:
+	struct Stats {
+		size_t allocations{ 0 }; // Blocks taken from the system
+		size_t reused{ 0 }; // Blocks taken from the pool
+		size_t cached_bytes{ 0 }; // Bytes waiting in the pool now
+		size_t live_bytes{ 0 }; // Bytes in use now
+		size_t peak_bytes{ 0 };
+		size_t category_live[PIXCATS_AMOUNT]{};
+		size_t category_peak[PIXCATS_AMOUNT]{};
+	};
+
+	//Throws std::bad_alloc, after printing what takes the memory, if it would go over SetLimit().
+	static void* Allocate(size_t bytes);
+	static void Free(void* block, size_t bytes);
+	//Bytes the pool may keep. Blocks freed above it go back to the system.
+	static void SetCacheLimit(size_t bytes);
+	//Bytes in use that Allocate() may not go over. 0 - no limit.
+	static void SetLimit(size_t bytes);
+	//Gives all the kept blocks back to the system.
+	static void Trim();
+	static Stats GetStats();
+
+	//A new job id for PixelScope. Jobs are counted separately from the start of their first scope.
+	static int NewJob();
+	//Call once, when the job is done. Its count is dropped as soon as none of its buffers are left.
+	static size_t JobPeak(int job);
+	static const char* CategoryName(int category);
+
+	static constexpr size_t ALIGNMENT = 64;
+};
+
+// PixelScope jobs that aren't PixelPool::NewJob() ids.
+enum PixelJobs {
+	PIXJOB_NONE = -2, // Counted to no job, even inside the scope of one
+	PIXJOB_INHERIT = -1 // The job of the scope around it
+};
+
+//Pixel buffers made on this thread until the end of the scope are counted to the category, and to the job.
+class PixelScope {
+public:
+	explicit PixelScope(int category, int job = PIXJOB_INHERIT);
+	~PixelScope();
+	PixelScope(const PixelScope&) = delete;
+	PixelScope& operator=(const PixelScope&) = delete;
+
+private:
+	int category_;
+	int job_;
+};
+
+template <class T>
+struct PoolAllocator {
+	typedef T value_type;
+
+	PoolAllocator() noexcept {}
+	template <class U> PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+	T* allocate(size_t n) { return static_cast<T*>(PixelPool::Allocate(n * sizeof(T))); }
+	void deallocate(T* block, size_t n) noexcept { PixelPool::Free(block, n * sizeof(T)); }
+
+	template <class U> bool operator==(const PoolAllocator<U>&) const noexcept { return true; }
+	template <class U> bool operator!=(const PoolAllocator<U>&) const noexcept { return false; }
+};
+
+typedef std::vector<unsigned char, PoolAllocator<unsigned char>> PixelBuffer;
+
+#endif // !PixelPool_h_
@@ -0,0 +1,31 @@
+#ifndef Portability_h_
+#define Portability_h_
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+/*
+The MSVC library names the code is written with, for GCC and Clang builds (see CMakeLists.txt).
+*/
+#ifndef _MSC_VER
+#define printf_s printf
+#ifndef _MAX_PATH
+#define _MAX_PATH 260
+#endif
+
+// Only the array form of sprintf_s is used, it knows the buffer size.
+template<size_t N, class... Args>
+int sprintf_s(char (&buffer)[N], const char* format, Args... args) {
+	return snprintf(buffer, N, format, args...);
+}
+
+#ifdef __GLIBCXX__
+// libstdc++ leaves the float names of <cmath> out of std.
+namespace std {
+	using ::ceilf;
+}
+#endif
+#endif // !_MSC_VER
+
+#endif // !Portability_h_
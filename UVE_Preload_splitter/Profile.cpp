@@ -0,0 +1,172 @@
+#include "Profile.h"
+#include "PixelPool.h"
+#include "Portability.h"
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+static const char* StageNames[PROFSTAGES_AMOUNT] = {
+	"open", "trim", "sizes", "pack", "blit", "save", "preload", "export", "sheet"
+};
+static const char* CounterNames[PROFCOUNTERS_AMOUNT] = {
+	"pack_attempts", "free_rects_scanned", "free_rects_peak", "pixels_blitted",
+	"bytes_read", "bytes_written", "setpixel_rejects"
+};
+
+struct ProfileEntry {
+	std::string name{};
+	int stage{ 0 };
+	double seconds{ 0 };
+};
+
+static std::atomic<long long> stage_ns[PROFSTAGES_AMOUNT]{};
+static std::atomic<long long> stage_calls[PROFSTAGES_AMOUNT]{};
+static std::atomic<long long> counters[PROFCOUNTERS_AMOUNT]{};
+static std::mutex profile_mutex{};
+static std::map<std::pair<int, int>, long long> pack_attempts{}; // (w, h) -> tries
+static std::vector<ProfileEntry> profile_entries{};
+
+void Profile::Enable(bool enabled) {
+	enabled_ = enabled;
+}
+
+void Profile::AddTime(int stage, double seconds) {
+	if (!Enabled()) {
+		return;
+	}
+	stage_ns[stage] += static_cast<long long>(seconds * 1e9);
+	++stage_calls[stage];
+}
+
+void Profile::Add(int counter, long long value) {
+	if (!Enabled()) {
+		return;
+	}
+	counters[counter] += value;
+}
+
+void Profile::Max(int counter, long long value) {
+	if (!Enabled()) {
+		return;
+	}
+	long long current = counters[counter];
+	while (value > current && !counters[counter].compare_exchange_weak(current, value)) {}
+}
+
+void Profile::AddAttempt(int w, int h) {
+	if (!Enabled()) {
+		return;
+	}
+	++counters[PROFCOUNT_PACK_ATTEMPTS];
+	std::lock_guard<std::mutex> lock(profile_mutex);
+	++pack_attempts[{ w, h }];
+}
+
+void Profile::AddEntry(const std::string& name, int stage, double seconds) {
+	if (!Enabled()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(profile_mutex);
+	profile_entries.push_back({ name, stage, seconds });
+}
+
+void Profile::PrintSummary() {
+	printf_s("\nProfile\n%-10s %10s %12s\n", "Stage", "Calls", "Total ms");
+	for (int i = 0; i < PROFSTAGES_AMOUNT; ++i) {
+		if (stage_calls[i]) {
+			printf_s("%-10s %10lld %12.3f\n", StageNames[i], stage_calls[i].load(), stage_ns[i] / 1e6);
+		}
+	}
+	printf_s("Counters\n");
+	for (int i = 0; i < PROFCOUNTERS_AMOUNT; ++i) {
+		printf_s("%-20s %lld\n", CounterNames[i], counters[i].load());
+	}
+	std::lock_guard<std::mutex> lock(profile_mutex);
+	printf_s("Atlas sizes tried: %zu\n", pack_attempts.size());
+}
+
+// Paths have backslashes on Windows.
+static std::string JsonString(const std::string& str) {
+	std::string result = "\"";
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			result += '\\';
+		}
+		if (static_cast<unsigned char>(c) < 0x20) {
+			char escaped[8] = { 0 };
+			sprintf_s(escaped, "\\u%04x", c);
+			result += escaped;
+			continue;
+		}
+		result += c;
+	}
+	return result + "\"";
+}
+
+int Profile::SaveJson(const std::string& path) {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file) {
+		return 0;
+	}
+	file << "{\n\t\"stages\": {";
+	bool first = true;
+	for (int i = 0; i < PROFSTAGES_AMOUNT; ++i) {
+		file << (first ? "\n" : ",\n") << "\t\t\"" << StageNames[i] << "\": { \"calls\": " << stage_calls[i].load()
+			<< ", \"ms\": " << stage_ns[i] / 1e6 << " }";
+		first = false;
+	}
+	file << "\n\t},\n\t\"counters\": {";
+	first = true;
+	for (int i = 0; i < PROFCOUNTERS_AMOUNT; ++i) {
+		file << (first ? "\n" : ",\n") << "\t\t\"" << CounterNames[i] << "\": " << counters[i].load();
+		first = false;
+	}
+	PixelPool::Stats memory = PixelPool::GetStats();
+	file << "\n\t},\n\t\"memory_peak\": {\n\t\t\"total\": " << memory.peak_bytes;
+	for (int i = 0; i < PIXCATS_AMOUNT; ++i) {
+		file << ",\n\t\t\"" << PixelPool::CategoryName(i) << "\": " << memory.category_peak[i];
+	}
+	std::lock_guard<std::mutex> lock(profile_mutex);
+	file << "\n\t},\n\t\"pack_sizes\": [";
+	first = true;
+	for (const auto& attempt : pack_attempts) {
+		file << (first ? "\n" : ",\n") << "\t\t{ \"w\": " << attempt.first.first << ", \"h\": " << attempt.first.second
+			<< ", \"attempts\": " << attempt.second << " }";
+		first = false;
+	}
+	file << "\n\t],\n\t\"entries\": [";
+	first = true;
+	for (const ProfileEntry& entry : profile_entries) {
+		file << (first ? "\n" : ",\n") << "\t\t{ \"name\": " << JsonString(entry.name) << ", \"stage\": \"" << StageNames[entry.stage]
+			<< "\", \"ms\": " << entry.seconds * 1e3 << " }";
+		first = false;
+	}
+	file << "\n\t]\n}\n";
+	return file ? 1 : 0;
+}
+
+ProfileScope::ProfileScope(int stage, const std::string* entry) :
+	stage_(stage), entry_(entry), enabled_(Profile::Enabled())
+{
+	if (enabled_) {
+		start_ = std::chrono::steady_clock::now();
+	}
+}
+
+ProfileScope::~ProfileScope() {
+	Stop();
+}
+
+void ProfileScope::Stop() {
+	if (!enabled_) {
+		return;
+	}
+	enabled_ = false;
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+	Profile::AddTime(stage_, seconds);
+	if (entry_) {
+		Profile::AddEntry(*entry_, stage_, seconds);
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef Profile_h_
+#define Profile_h_
+
+#include <string>
+#include <atomic>
+#include <chrono>
+
+/*
+--profile: wall time per stage and per entry, and counters of the hot paths.
+Shared by all threads. Nothing is recorded (and almost nothing is done) unless it's enabled.
+*/
+enum ProfileStages {
+	PROFSTAGE_OPEN,
+	PROFSTAGE_TRIM,
+	PROFSTAGE_SIZES,
+	PROFSTAGE_PACK,
+	PROFSTAGE_BLIT,
+	PROFSTAGE_SAVE,
+	PROFSTAGE_PRELOAD,
+	PROFSTAGE_EXPORT,
+	PROFSTAGE_SHEET,
+	PROFSTAGES_AMOUNT
+};
+
+enum ProfileCounters {
+	PROFCOUNT_PACK_ATTEMPTS,
+	PROFCOUNT_FREE_RECTS_SCANNED,
+	PROFCOUNT_FREE_RECTS_PEAK,
+	PROFCOUNT_PIXELS_BLITTED,
+	PROFCOUNT_BYTES_READ,
+	PROFCOUNT_BYTES_WRITTEN,
+	PROFCOUNT_SETPIXEL_REJECTS,
+	PROFCOUNTERS_AMOUNT
+};
+
+class Profile {
+public:
+	static void Enable(bool enabled);
+	static bool Enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+	static void AddTime(int stage, double seconds);
+	static void Add(int counter, long long value);
+	static void Max(int counter, long long value);
+	//One PackAtlas() try with the candidate atlas size.
+	static void AddAttempt(int w, int h);
+	//Time a single file spent in a stage.
+	static void AddEntry(const std::string& name, int stage, double seconds);
+
+	static void PrintSummary();
+	static int SaveJson(const std::string& path);
+
+private:
+	static inline std::atomic<bool> enabled_{ false };
+};
+
+//Adds the time until the end of the scope to the stage, and to the entry if there is one.
+class ProfileScope {
+public:
+	explicit ProfileScope(int stage, const std::string* entry = nullptr);
+	~ProfileScope();
+	//Records the time now instead of at the end of the scope.
+	void Stop();
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	int stage_;
+	const std::string* entry_;
+	bool enabled_;
+	std::chrono::steady_clock::time_point start_;
+};
+
+#endif // !Profile_h_
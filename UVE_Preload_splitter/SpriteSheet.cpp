@@ -0,0 +1,145 @@
+#include "SpriteSheet.h"
+#include "Parallel.h"
+#include "Profile.h"
+#include "PixelPool.h"
+#include "Portability.h"
+#include "OutputCache.h"
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <new>
+
+SpriteSheet::SpriteSheet() : vertical_(true), flip_(true), threads_(0) {}
+
+void SpriteSheet::SetVertical(bool vertical) {
+	vertical_ = vertical;
+}
+
+void SpriteSheet::SetFlip(bool flip) {
+	flip_ = flip;
+}
+
+void SpriteSheet::SetThreads(int threads) {
+	threads_ = threads;
+}
+
+bool SpriteSheet::RenderCell(Targa& out, const Targa& atlas, const IniPreload& preload, const PreloadFrameData& cell, int index) const {
+	const PreloadFrameData& fr = preload.frames[index];
+	int middle_x = static_cast<int>(std::ceil(static_cast<float>(fr.w - 1) / 2.f));
+	int middle_y = static_cast<int>(std::ceil(static_cast<float>(fr.h - 1) / 2.f));
+	int ixo = static_cast<int>(std::floor(fr.xo + 0.5f));
+	int iyo = static_cast<int>(std::floor(fr.yo + 0.5f));
+
+	std::fill(out.data.begin(), out.data.end(), 0);
+	return out.CopyRegion(atlas,
+		fr.x, fr.y,
+		cell.x - middle_x + ixo,
+		cell.y - middle_y + iyo,
+		fr.w, fr.h,
+		(preload.format_version == IniPreload::VERSION_FLOAT),
+		!flip_);
+}
+
+int SpriteSheet::Save(const std::string& path, const Targa& atlas, const IniPreload& preload, const PreloadFrameData& cell) {
+	ProfileScope profile(PROFSTAGE_SHEET);
+	bad_frames = 0;
+	int frames = static_cast<int>(preload.frames.size());
+	if (frames == 0 || cell.w <= 0 || cell.h <= 0) {
+		return 0;
+	}
+
+	TargaHeader cell_header = atlas.GetHeader();
+	cell_header.w = cell.w;
+	cell_header.h = cell.h;
+	Targa sheet{};
+	sheet.x = cell_header.x;
+	sheet.y = cell_header.y;
+	sheet.w = vertical_ ? cell.w : cell.w * frames;
+	sheet.h = vertical_ ? cell.h * frames : cell.h;
+	sheet.image_type = cell_header.image_type;
+	sheet.colour_depth = cell_header.colour_depth;
+	sheet.image_descriptor = cell_header.image_descriptor;
+
+	size_t bpp = sheet.colour_depth >> 3;
+	size_t row_bytes = static_cast<size_t>(sheet.w) * bpp;
+	size_t cell_row_bytes = static_cast<size_t>(cell.w) * bpp;
+	size_t data_size = row_bytes * sheet.h;
+	const std::streamoff header_size = 18;
+
+	// Size the file first so every worker can seek to its own cell.
+	{
+		OutputCache::Unshare(path);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			return 0;
+		}
+		sheet.WriteHeader(file);
+		if (data_size) {
+			file.seekp(header_size + static_cast<std::streamoff>(data_size) - 1);
+			file.put(0);
+		}
+		if (!file) {
+			return 0;
+		}
+		Profile::Add(PROFCOUNT_BYTES_WRITTEN, header_size + data_size);
+	}
+
+	int threads = std::min(ThreadsAmount(threads_), frames);
+
+	std::atomic<int> next_frame{ 0 };
+	std::atomic<int> bad{ 0 };
+	std::atomic<bool> failed{ false };
+
+	auto worker = [&]() {
+		std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+		if (!file) {
+			failed = true;
+			return;
+		}
+		PixelScope memory(PIXCAT_EXPORT);
+		try {
+			Targa out{};
+			out.SetHeader(cell_header);
+			for (int j = next_frame++; j < frames && !failed; j = next_frame++) {
+				if (!RenderCell(out, atlas, preload, cell, j)) {
+					printf_s("Bad frame %d! It does not fit the atlas or the sheet.\n", j);
+					++bad;
+				}
+				// Cell rows keep their order in the file. Only the first sheet row of the cell depends on the flip.
+				if (vertical_) {
+					size_t first_row = flip_ ? static_cast<size_t>(sheet.h) - static_cast<size_t>(j + 1) * cell.h : static_cast<size_t>(j) * cell.h;
+					file.seekp(header_size + static_cast<std::streamoff>(first_row * row_bytes));
+					file.write(reinterpret_cast<const char*>(out.data.data()), out.data.size());
+				}
+				else {
+					for (int row = 0; row < cell.h; ++row) {
+						file.seekp(header_size + static_cast<std::streamoff>(row * row_bytes + j * cell_row_bytes));
+						file.write(reinterpret_cast<const char*>(out.data.data() + row * cell_row_bytes), cell_row_bytes);
+					}
+				}
+				if (!file) {
+					failed = true;
+				}
+			}
+		}
+		catch (const std::bad_alloc&) {
+			printf_s("Out of memory when making the sprite sheet cells.\n");
+			failed = true;
+		}
+	};
+
+	std::vector<std::thread> pool{};
+	for (int i = 1; i < threads; ++i) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& t : pool) {
+		t.join();
+	}
+
+	bad_frames = bad;
+	return failed ? 0 : 1;
+}
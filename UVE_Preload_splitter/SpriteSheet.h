@@ -0,0 +1,32 @@
+#ifndef SpriteSheet_h_
+#define SpriteSheet_h_
+
+#include <string>
+#include "Targa.h"
+#include "IniPreload.h"
+
+/*
+Writes a sprite sheet straight to the file, one cell at a time.
+Every worker renders a single cell into its own buffer and puts it
+at the cell's place in the file, so the whole sheet is never kept in memory.
+*/
+class SpriteSheet {
+public:
+	SpriteSheet();
+	void SetVertical(bool vertical);
+	void SetFlip(bool flip);
+	void SetThreads(int threads);
+	// cell is the result of CalculateTotalFrameSize(): x, y is the middle, w, h is the cell size.
+	int Save(const std::string& path, const Targa& atlas, const IniPreload& preload, const PreloadFrameData& cell);
+
+	int bad_frames{ 0 };
+
+private:
+	bool RenderCell(Targa& out, const Targa& atlas, const IniPreload& preload, const PreloadFrameData& cell, int index) const;
+
+	bool vertical_;
+	bool flip_;
+	int threads_;
+};
+
+#endif // !SpriteSheet_h_
@@ -1,6 +1,10 @@
 #include "Targa.h"
 
 #include <fstream>
+#include <cstring>
+#include <sstream>
+#include "Profile.h"
+#include "OutputCache.h"
 /*
 The bitsperpixel specifies the size of each colour value.
 When 24 or 32 the normal conventions apply.
@@ -10,16 +14,59 @@ The colour components are converted into single byte components
 by simply shifting each component up by 3 bits (multiply by 8).
 */
 
-const PixelData DebugColourTransparency = { 255 * 0.25, 255, 0, 255 }; // 25% pink fill
+const PixelData DebugColourTransparency = { 255 / 4, 255, 0, 255 }; // 25% pink fill
 
 Targa::Targa() :
 	x{ 0 }, y{ 0 }, w{ 0 }, h{ 0 },
 	image_type{ 0 }, colour_depth{ 0 }, image_descriptor{ 0 }
 {}
 
+Targa::Targa(const Targa& other) :
+	data(other.Pixels(), other.Pixels() + other.PixelsSize()),
+	x{ other.x }, y{ other.y }, w{ other.w }, h{ other.h },
+	image_type{ other.image_type }, colour_depth{ other.colour_depth }, image_descriptor{ other.image_descriptor }
+{}
+
+Targa& Targa::operator=(const Targa& other) {
+	if (this != &other) {
+		*this = Targa(other);
+	}
+	return *this;
+}
+
 Targa::~Targa() {}
 
 int Targa::Open(const std::string& path) {
+	ProfileScope profile(PROFSTAGE_OPEN, &path);
+	PixelScope memory(PIXCAT_SOURCE);
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return 0;
+	}
+	int result = Open(file);
+	file.close();
+	return result;
+}
+
+int Targa::Open(std::istream& file) {
+	std::streampos start = file.tellg();
+	file.seekg(start + std::streamoff(2));
+	image_type = file.get();
+	file.seekg(start + std::streamoff(8));
+	file.read(reinterpret_cast<char*>(&x), 2);
+	file.read(reinterpret_cast<char*>(&y), 2);
+	file.read(reinterpret_cast<char*>(&w), 2);
+	file.read(reinterpret_cast<char*>(&h), 2);
+	colour_depth = file.get();
+	image_descriptor = file.get();
+	mapped_.reset();
+	data.resize(w*h*(colour_depth/8));/*!!!*/
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+	Profile::Add(PROFCOUNT_BYTES_READ, HEADER_SIZE + data.size());
+	return 1;
+}
+
+int Targa::OpenHeader(const std::string& path) {
 	std::ifstream file(path, std::ios::binary);
 	if (!file) {
 		return 0;
@@ -33,31 +80,62 @@ int Targa::Open(const std::string& path) {
 	file.read(reinterpret_cast<char*>(&h), 2);
 	colour_depth = file.get();
 	image_descriptor = file.get();
-	data.resize(w*h*(colour_depth/8));/*!!!*/
+	mapped_.reset();
+	data.clear();
+	return file ? 1 : 0;
+}
+
+int Targa::OpenRows(const std::string& path, int first_row, int rows) {
+	ProfileScope profile(PROFSTAGE_OPEN, &path);
+	PixelScope memory(PIXCAT_SOURCE);
+	if (!OpenHeader(path)) {
+		return 0;
+	}
+	if (first_row < 0 || rows < 0 || first_row + rows > h) {
+		return 0;
+	}
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return 0;
+	}
+	size_t row_size = static_cast<size_t>(w) * (colour_depth / 8);
+	h = static_cast<unsigned short>(rows);
+	data.resize(row_size * rows);
+	file.seekg(HEADER_SIZE + static_cast<std::streamoff>(row_size) * first_row);
 	file.read(reinterpret_cast<char*>(data.data()), data.size());
+	Profile::Add(PROFCOUNT_BYTES_READ, data.size());
 	file.close();
 	return 1;
 }
 
 int Targa::Save(const std::string& path) {
+	ProfileScope profile(PROFSTAGE_SAVE, &path);
+	OutputCache::Unshare(path);
 	std::ofstream file(path, std::ios::binary | std::ios::trunc);
 	if (!file) {
 		return 0;
 	}
+	Save(file);
+	file.close();
+	return file.good() ? 1 : 0;
+}
+
+void Targa::Save(std::ostream& file) const {
+	WriteHeader(file);
+	file.write(reinterpret_cast<const char*>(Pixels()), PixelsSize());
+	Profile::Add(PROFCOUNT_BYTES_WRITTEN, HEADER_SIZE + PixelsSize());
+}
 
-	/* Header */
+void Targa::WriteHeader(std::ostream& file) const {
 	file.put(0); file.put(0);
 	file.put(image_type);
 	file.put(0); file.put(0); file.put(0); file.put(0); file.put(0);
-	file.write(reinterpret_cast<char*>(&x), 2);
-	file.write(reinterpret_cast<char*>(&y), 2);
-	file.write(reinterpret_cast<char*>(&w), 2);
-	file.write(reinterpret_cast<char*>(&h), 2);
+	file.write(reinterpret_cast<const char*>(&x), 2);
+	file.write(reinterpret_cast<const char*>(&y), 2);
+	file.write(reinterpret_cast<const char*>(&w), 2);
+	file.write(reinterpret_cast<const char*>(&h), 2);
 	file.put(colour_depth);
 	file.put(image_descriptor);
-	file.write(reinterpret_cast<char*>(data.data()), data.size());
-	file.close();
-	return 1;
 }
 
 void Targa::SetHeader(const TargaHeader& header) {
@@ -69,29 +147,82 @@ void Targa::SetHeader(const TargaHeader& header) {
 	colour_depth = header.colour_depth;
 	image_descriptor = header.image_descriptor;
 	
+	mapped_.reset();
 	data.resize(w * h * (colour_depth >> 3));
 }
 
+int Targa::Map(const std::string& path, const TargaHeader& header) {
+	x = header.x;
+	y = header.y;
+	w = header.w;
+	h = header.h;
+	image_type = header.image_type;
+	colour_depth = header.colour_depth;
+	image_descriptor = header.image_descriptor;
+	mapped_.reset();
+	PixelBuffer().swap(data);
+
+	std::ostringstream header_bytes{};
+	WriteHeader(header_bytes);
+	std::string bytes = header_bytes.str();
+	size_t pixels_size = static_cast<size_t>(w) * h * (colour_depth >> 3);
+
+	std::unique_ptr<MappedFile> mapped = std::make_unique<MappedFile>();
+	if (!mapped->Create(path, bytes.size() + pixels_size)) {
+		w = h = 0;
+		return 0;
+	}
+	std::memcpy(mapped->GetView(), bytes.data(), bytes.size());
+	mapped_ = std::move(mapped);
+	return 1;
+}
+
+int Targa::Unmap() {
+	if (!mapped_) {
+		return 0;
+	}
+	ProfileScope profile(PROFSTAGE_SAVE);
+	Profile::Add(PROFCOUNT_BYTES_WRITTEN, mapped_->GetSize());
+	int result = mapped_->Close();
+	mapped_.reset();
+	w = h = 0;
+	return result;
+}
+
+unsigned char* Targa::Pixels() {
+	return mapped_ ? mapped_->GetView() + HEADER_SIZE : data.data();
+}
+
+const unsigned char* Targa::Pixels() const {
+	return mapped_ ? mapped_->GetView() + HEADER_SIZE : data.data();
+}
+
+size_t Targa::PixelsSize() const {
+	return mapped_ ? mapped_->GetSize() - HEADER_SIZE : data.size();
+}
+
 bool Targa::SetPixel(int x, int y, const PixelData& px, bool bottom_to_top) {
 	//int px_d = x + x*y;
 	int px_d = (bottom_to_top) ? x + w * y : x + w * (h-y-1);
-	if (px_d * colour_depth >> 3 > data.size() || px_d < 0) {
+	unsigned char* pixels = Pixels();
+	if (px_d * colour_depth >> 3 > PixelsSize() || px_d < 0) {
+		Profile::Add(PROFCOUNT_SETPIXEL_REJECTS, 1);
 		return false;
 	}
 	switch (colour_depth) {
 		case 32:	
-			data[px_d * 4] 	= px.b;
-			data[px_d * 4 + 1] = px.g;
-			data[px_d * 4 + 2] = px.r;
-			data[px_d * 4 + 3] = px.a;
+			pixels[px_d * 4] 	= px.b;
+			pixels[px_d * 4 + 1] = px.g;
+			pixels[px_d * 4 + 2] = px.r;
+			pixels[px_d * 4 + 3] = px.a;
 			break;
 		case 24:
-			data[px_d * 3] 	= px.b;
-			data[px_d * 3 + 1] = px.g;
-			data[px_d * 3 + 2] = px.r;
+			pixels[px_d * 3] 	= px.b;
+			pixels[px_d * 3 + 1] = px.g;
+			pixels[px_d * 3 + 2] = px.r;
 			break;
 		case 8:
-			data[px_d] = px.r;
+			pixels[px_d] = px.r;
 			break;
 		default:
 			break;
@@ -103,20 +234,21 @@ PixelData Targa::GetPixel(int x, int y, bool bottom_to_top) const {
 	//int px_d = x + x*y;// Created a cool looking noise bug
 	int px_d = (bottom_to_top) ? x + w * y : x + w * (h-y-1);
 	PixelData px{0};
+	const unsigned char* pixels = Pixels();
 	switch (colour_depth) {
 		case 32:
-			px.b = data[px_d * 4];
-			px.g = data[px_d * 4 + 1];
-			px.r = data[px_d * 4 + 2];
-			px.a = data[px_d * 4 + 3];
+			px.b = pixels[px_d * 4];
+			px.g = pixels[px_d * 4 + 1];
+			px.r = pixels[px_d * 4 + 2];
+			px.a = pixels[px_d * 4 + 3];
 			break;
 		case 24:
-			px.b = data[px_d * 3];
-			px.g = data[px_d * 3 + 1];
-			px.r = data[px_d * 3 + 2];
+			px.b = pixels[px_d * 3];
+			px.g = pixels[px_d * 3 + 1];
+			px.r = pixels[px_d * 3 + 2];
 			break;
 		case 8:
-			px.r = data[px_d];
+			px.r = pixels[px_d];
 			break;
 		default:
 			break;
@@ -124,9 +256,10 @@ PixelData Targa::GetPixel(int x, int y, bool bottom_to_top) const {
 	return px;
 }
 
-std::vector<PixelData> Targa::GetRegion(int x, int y, int w, int h, bool bottom_to_top) const {
+PixelRegion Targa::GetRegion(int x, int y, int w, int h, bool bottom_to_top) const {
 	size_t res_size = std::abs(w*h);
-	std::vector<PixelData> res{res_size};
+	PixelScope memory(PIXCAT_REGION);
+	PixelRegion res(res_size);
 	int
 		x_from = x,
 		x_to = x_from + w,//+1
@@ -141,7 +274,7 @@ std::vector<PixelData> Targa::GetRegion(int x, int y, int w, int h, bool bottom_
 	return res;
 }
 
-bool Targa::BlitRegion(const std::vector<PixelData>& _data, int x, int y, int w, int h, bool bottom_to_top) {
+bool Targa::BlitRegion(const PixelRegion& _data, int x, int y, int w, int h, bool bottom_to_top) {
 	int
 		x_from = x,
 		x_to = x_from + w,//+1
@@ -152,10 +285,10 @@ bool Targa::BlitRegion(const std::vector<PixelData>& _data, int x, int y, int w,
 		for (int _x = x_from; _x < x_to; ++_x) {
 			if (!SetPixel(_x, _y, _data[(_x - x_from) + std::abs(_y - y_from) * w], true)) { return false; }
 		}
-	}
+	}	return true;
 }
 
-bool Targa::BlitRegionTransparent(const std::vector<PixelData>& _data, int x, int y, int w, int h, bool bottom_to_top, uint8_t a_, bool show_transparency) {
+bool Targa::BlitRegionTransparent(const PixelRegion& _data, int x, int y, int w, int h, bool bottom_to_top, uint8_t a_, bool show_transparency) {
 	int x_from = x,
 		x_to = x_from + w,//+1
 		y_from = bottom_to_top ? y : this->h - y - 1,
@@ -200,6 +333,81 @@ bool Targa::PixelIsTransparent(const PixelData& px, bool alpha_only) {
 	}
 }
 
+// Same channel mapping as SetPixel(GetPixel()): 24 bit has no alpha, 8 bit is the red channel.
+static void ConvertRow(const unsigned char* src, int src_bpp, unsigned char* dst, int dst_bpp, int w) {
+	for (int i = 0; i < w; ++i, src += src_bpp, dst += dst_bpp) {
+		if (dst_bpp == 1) {
+			dst[0] = (src_bpp == 1) ? src[0] : src[2];
+			continue;
+		}
+		if (src_bpp == 1) {
+			dst[0] = 0;
+			dst[1] = 0;
+			dst[2] = src[0];
+		}
+		else {
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+		}
+		if (dst_bpp == 4) {
+			dst[3] = (src_bpp == 4) ? src[3] : 0;
+		}
+	}
+}
+
+bool Targa::CopyRegion(const Targa& src, int src_x, int src_y, int dst_x, int dst_y, int w, int h, bool src_bottom_to_top, bool dst_bottom_to_top) {
+	int src_bpp = src.colour_depth >> 3,
+		dst_bpp = colour_depth >> 3;
+	if (w < 0 || h < 0 || !src_bpp || !dst_bpp ||
+		src_x < 0 || src_y < 0 || src_x + w > src.w || src_y + h > src.h ||
+		dst_x < 0 || dst_y < 0 || dst_x + w > this->w || dst_y + h > this->h ||
+		src.PixelsSize() < static_cast<size_t>(src.w) * src.h * src_bpp ||
+		PixelsSize() < static_cast<size_t>(this->w) * this->h * dst_bpp) {
+		return false;
+	}
+
+	for (int row = 0; row < h; ++row) {
+		int src_row = src_bottom_to_top ? src_y + row : src.h - (src_y + row) - 1;
+		int dst_row = dst_bottom_to_top ? dst_y + row : this->h - (dst_y + row) - 1;
+		const unsigned char* src_px = src.Pixels() + (static_cast<size_t>(src_row) * src.w + src_x) * src_bpp;
+		unsigned char* dst_px = Pixels() + (static_cast<size_t>(dst_row) * this->w + dst_x) * dst_bpp;
+		if (src_bpp == dst_bpp) {
+			std::memcpy(dst_px, src_px, static_cast<size_t>(w) * dst_bpp);
+		}
+		else {
+			ConvertRow(src_px, src_bpp, dst_px, dst_bpp, w);
+		}
+	}
+	return true;
+}
+
+bool Targa::CopyRegionTransparent(const Targa& src, int src_x, int src_y, int dst_x, int dst_y, int w, int h, bool src_bottom_to_top, bool dst_bottom_to_top, bool show_transparency) {
+	if (src.colour_depth != 8 || colour_depth != 8 || w < 0 || h < 0 ||
+		src_x < 0 || src_y < 0 || src_x + w > src.w || src_y + h > src.h ||
+		dst_x < 0 || dst_y < 0 || dst_x + w > this->w || dst_y + h > this->h ||
+		src.PixelsSize() < static_cast<size_t>(src.w) * src.h ||
+		PixelsSize() < static_cast<size_t>(this->w) * this->h) {
+		return false;
+	}
+
+	for (int row = 0; row < h; ++row) {
+		int src_row = src_bottom_to_top ? src_y + row : src.h - (src_y + row) - 1;
+		int dst_row = dst_bottom_to_top ? dst_y + row : this->h - (dst_y + row) - 1;
+		const unsigned char* src_px = src.Pixels() + static_cast<size_t>(src_row) * src.w + src_x;
+		unsigned char* dst_px = Pixels() + static_cast<size_t>(dst_row) * this->w + dst_x;
+		for (int i = 0; i < w; ++i) {
+			if (src_px[i]) {
+				dst_px[i] = src_px[i];
+			}
+			else if (show_transparency) {
+				dst_px[i] = DebugColourTransparency.r;
+			}
+		}
+	}
+	return true;
+}
+
 TargaHeader Targa::GetHeader() const {
 	TargaHeader header;
 	header.x = x;
@@ -3,6 +3,11 @@
 
 #include <vector>
 #include <string>
+#include <istream>
+#include <ostream>
+#include <memory>
+#include "PixelPool.h"
+#include "MappedFile.h"
 
 //For TGA
 struct TargaHeader {
@@ -24,23 +29,50 @@ struct PixelData {
 	bool operator==(const PixelData& other) const;
 };
 
+typedef std::vector<PixelData, PoolAllocator<PixelData>> PixelRegion;
+
 class Targa {
 public:
 	Targa();
+	Targa(const Targa& other); // A copy of a mapped image lives in memory
+	Targa(Targa&&) = default; // Pack entries are moved around a lot, don't copy the pixels
+	Targa& operator=(const Targa& other);
+	Targa& operator=(Targa&&) = default;
 	~Targa();
 	int Open(const std::string& path);
+	int Open(std::istream& file);
+	//Reads the header only, data stays empty.
+	int OpenHeader(const std::string& path);
+	//Reads rows [first_row, first_row + rows) as they are stored in the file, h becomes rows.
+	int OpenRows(const std::string& path, int first_row, int rows);
 	int Save(const std::string& path);
+	void Save(std::ostream& file) const;
+	//Writes the 18 byte header only, pixel data is expected to follow.
+	void WriteHeader(std::ostream& file) const;
 	void SetHeader(const TargaHeader& header);
+	//Like SetHeader(), but the pixels live in a new file at path instead of data. Unmap() finishes the file.
+	int Map(const std::string& path, const TargaHeader& header);
+	int Unmap();
+	//data, or the mapped file pixels.
+	unsigned char* Pixels();
+	const unsigned char* Pixels() const;
+	size_t PixelsSize() const;
 	TargaHeader GetHeader() const;
 	bool SetPixel(int x, int y, const PixelData& px, bool bottom_to_top = true);
 	PixelData GetPixel(int x, int y, bool bottom_to_top = true) const;
 	//The resulting region is always upside down for consistence
-	std::vector<PixelData> GetRegion(int x, int y, int w, int h, bool bottom_to_top = true) const;
-	bool BlitRegion(const std::vector<PixelData>& _data, int x, int y, int w, int h, bool bottom_to_top = true);
-	bool BlitRegionTransparent(const std::vector<PixelData>& _data, int x, int y, int w, int h, bool bottom_to_top = true, uint8_t a_ = 255, bool show_transparency = false);//Do not place pixel if it's transparent
+	PixelRegion GetRegion(int x, int y, int w, int h, bool bottom_to_top = true) const;
+	bool BlitRegion(const PixelRegion& _data, int x, int y, int w, int h, bool bottom_to_top = true);
+	bool BlitRegionTransparent(const PixelRegion& _data, int x, int y, int w, int h, bool bottom_to_top = true, uint8_t a_ = 255, bool show_transparency = false);//Do not place pixel if it's transparent
 	bool PixelIsTransparent(const PixelData& px, bool check_alpha_only = true);
+	//Copies a w*h block from src row by row. Fails without touching anything if the block leaves either image.
+	bool CopyRegion(const Targa& src, int src_x, int src_y, int dst_x, int dst_y, int w, int h, bool src_bottom_to_top = true, bool dst_bottom_to_top = true);
+	//CopyRegion() that skips transparent pixels, as BlitRegionTransparent() does. 8 bit images only, fails for others.
+	bool CopyRegionTransparent(const Targa& src, int src_x, int src_y, int dst_x, int dst_y, int w, int h, bool src_bottom_to_top = true, bool dst_bottom_to_top = true, bool show_transparency = false);
+
+	static const size_t HEADER_SIZE{ 18 };
 
-	std::vector<unsigned char> data{};
+	PixelBuffer data{};
 
 	unsigned short
 		x{0},
@@ -51,6 +83,9 @@ public:
 		image_type{0},
 		colour_depth{0},
 		image_descriptor{0};
+
+private:
+	std::unique_ptr<MappedFile> mapped_{};
 };
 
 #endif
\ No newline at end of file
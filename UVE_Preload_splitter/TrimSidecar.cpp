@@ -0,0 +1,95 @@
+#include "TrimSidecar.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+// Files are known by their absolute path, so the same input found two ways is one record.
+static std::string RecordKey(const std::string& file) {
+	std::error_code error{};
+	std::filesystem::path path = std::filesystem::absolute(file, error);
+	return error ? file : path.lexically_normal().generic_string();
+}
+
+TrimSidecar::TrimSidecar() : changed_(false) {}
+
+int TrimSidecar::Open(const std::string& path) {
+	path_ = path;
+	records_.clear();
+	changed_ = false;
+	std::ifstream file(path);
+	if (!file) {
+		return std::filesystem::exists(path) ? 0 : 1;
+	}
+	std::string line{};
+	while (std::getline(file, line)) {
+		size_t tab = line.find('\t');
+		if (tab == std::string::npos) {
+			continue;
+		}
+		std::istringstream fields(line.substr(0, tab));
+		TrimRecord record{};
+		if (fields >> record.stamp.size >> record.stamp.time >> record.image_w >> record.image_h
+			>> record.rect.w >> record.rect.h >> record.data_start.x >> record.data_start.y
+			>> record.offset.x >> record.offset.y) {
+			records_[line.substr(tab + 1)] = record;
+		}
+	}
+	return 1;
+}
+
+int TrimSidecar::Save() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!changed_ || path_.empty()) {
+		return 1;
+	}
+	// Written aside and renamed, a run stopped halfway leaves the old sidecar.
+	std::string temp = path_ + ".tmp";
+	{
+		std::ofstream file(temp, std::ios::trunc);
+		file << std::setprecision(9);
+		for (const auto& record : records_) {
+			const TrimRecord& r = record.second;
+			file << r.stamp.size << ' ' << r.stamp.time << ' ' << r.image_w << ' ' << r.image_h << ' '
+				<< r.rect.w << ' ' << r.rect.h << ' ' << r.data_start.x << ' ' << r.data_start.y << ' '
+				<< r.offset.x << ' ' << r.offset.y << '\t' << record.first << '\n';
+		}
+		if (!file) {
+			return 0;
+		}
+	}
+	std::error_code error{};
+	std::filesystem::rename(temp, path_, error);
+	if (error) {
+		return 0;
+	}
+	changed_ = false;
+	return 1;
+}
+
+bool TrimSidecar::Find(const std::string& file, FileStamp& stamp, TrimRecord& record) {
+	stamp = FileStamp{};
+	if (!FrameCache::Stamp(file, stamp)) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto found = records_.find(RecordKey(file));
+	if (found == records_.end() || found->second.stamp != stamp) {
+		return false;
+	}
+	record = found->second;
+	return true;
+}
+
+void TrimSidecar::Set(const std::string& file, const FileStamp& stamp, const AtlasEntry& entry) {
+	TrimRecord record{};
+	record.stamp = stamp;
+	record.image_w = entry.image.w;
+	record.image_h = entry.image.h;
+	record.rect = entry.rect;
+	record.data_start = entry.data_start;
+	record.offset = entry.offset;
+	std::lock_guard<std::mutex> lock(mutex_);
+	records_[RecordKey(file)] = record;
+	changed_ = true;
+}
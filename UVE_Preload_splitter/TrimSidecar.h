@@ -0,0 +1,44 @@
+#ifndef TrimSidecar_h_
+#define TrimSidecar_h_
+
+#include <string>
+#include <map>
+#include <mutex>
+#include "AtlasPack.h"
+#include "FrameCache.h"
+
+// What TrimEntry() found in one input file, and what the file was like then.
+struct TrimRecord {
+	FileStamp stamp{};
+	int image_w{ 0 }, image_h{ 0 };
+	Rect rect{};
+	Vector2 data_start{};
+	Vector2f offset{};
+};
+
+/*
+--trim-sidecar: remembers the trimmed rect of every packed TGA, so unchanged inputs aren't scanned again and only their trimmed rows are read.
+Text, a line per file: size, time, image w h, rect w h, data start x y, offset x y, then a tab and the path.
+Shared by the pack jobs of a task.
+*/
+class TrimSidecar {
+public:
+	TrimSidecar();
+	//A missing file is an empty sidecar.
+	int Open(const std::string& path);
+	//Writes the file again if anything was added.
+	int Save();
+	//The record of file if it still has the same size and time. stamp is what the file is like now.
+	bool Find(const std::string& file, FileStamp& stamp, TrimRecord& record);
+	//Call after TrimEntry() and before CropEntry(), while the entry still has the whole image.
+	//stamp is what the file was like before it was read (from Find()), a save meanwhile then doesn't match next time.
+	void Set(const std::string& file, const FileStamp& stamp, const AtlasEntry& entry);
+
+private:
+	std::string path_;
+	std::map<std::string, TrimRecord> records_;
+	bool changed_;
+	std::mutex mutex_;
+};
+
+#endif // !TrimSidecar_h_
@@ -1,18 +1,43 @@
 #include <iostream>
 #include <vector>
+#include <numeric>
+#include <fstream>
+#include <string>
+#include <new>
+#include <filesystem>
+#include <memory>
+#include <map>
+#include <chrono>
+#include <climits>
+#include <cerrno>
+#include <cstdlib>
 #include "IniPreload.h"
 #include "Targa.h"
 #include "AtlasPack.h"
+#include "SpriteSheet.h"
+#include "Bundle.h"
+#include "PackJob.h"
+#include "Parallel.h"
+#include "AsyncWriter.h"
+#include "Profile.h"
+#include "PixelPool.h"
+#include "Benchmark.h"
+#include "Corpus.h"
+#include "OutputCache.h"
+#include "TrimSidecar.h"
+#include "FrameCache.h"
+#include "DirWatcher.h"
+#include "Library.h"
+#include "FrameServer.h"
 #include "Debug.h"
+#include "Portability.h"
 
 /* Don't put 0 in the beginning. */
-#define VERSION 2'00'02'01
-#define VERSION_STR "2.0.2.1"
+#define VERSION 2'00'03'00
+#define VERSION_STR "2.0.3.0"
 #define ERRMSG_NOT_ENOUGH_ARGS(x) "Incorrect " x " usage: not enough arguments.\nRun without parameters to see usage examples.\n"
 #define ERRMSG_FILE(x) "An error occurred when trying to read/write " << x << ".\n"
 
-#define MIDDLE(w) (static_cast<float>(w-1)/2.f) // Ceil this if called with width/height to get a pixel coordinate for middle.
-
 #define CHKSET(x, y) {if ( (x) != (y) ) x = y;}
 
 #define SCREWUP printf_s("Something went wrong at  %s:%d", __func__, __LINE__)
@@ -29,6 +54,35 @@ TODO
 - Proper exe name arguments system.
 - Rework pack entries to support them independantly
 
+2.0.3.0
+- Frames are exported row by row instead of pixel by pixel. A frame that doesn't fit the atlas or the output image is reported once and skipped instead of spamming "Bad SetPixel!".
+- Sprite sheets are written straight to the file cell by cell on all cores instead of being built in memory first.
+- --bundle export option: all frames go to a single .tgab file with a frame index. --pack accepts .tgab files and takes every frame from them.
+- --repack mode: packs an existing atlas again with new padding/colour padding/power of two/preload type without exporting the frames.
+- --job pack option: several independent atlases per run, packed at the same time. --out sets the atlas path of a job, --threads limits the threads used.
+- --group pack option: several animations in one atlas, each with its own preload, --frames and --loop.
+- --frames 0 now really means automatic detection.
+- --merge mode: packs several atlas + preload pairs into one atlas, with a preload per pair.
+- --frames-range and --frame-list export options to export only some frames. Only the atlas rows these frames take are read.
+- Pack inputs are read and trimmed on all cores ahead of the atlas instead of one after another.
+- Pack entries keep only their trimmed pixels, the rest of each input is freed as soon as it's trimmed. Entries are sorted by their trimmed height only (the source height was mixed in before), so atlases may be laid out differently than in older versions.
+- Pixel buffers are taken from a pool of freed blocks instead of being allocated for every frame and region.
+- --greyscale packs convert every input to 8 bit right after trimming, so the inputs take a quarter of the memory and are copied to the atlas a row at a time. Like other 8 bit atlases, they no longer leave room for colour padding that is never drawn.
+- Exported frames are saved on writer threads while the next frames are cut out.
+- --profile and --profile-json options: time spent in every stage and per file, and counters of the packing and drawing hot paths.
+- --mapped-output pack option: the atlas is drawn straight into the file mapped to memory, without building it in memory and copying it to the file.
+- --trim-sidecar [file] pack option: the trimmed rect of every input is kept in the file. Inputs with the same size and time as then aren't scanned again, only their trimmed rows are read.
+- Library.h: export, pack and convert from memory (Targa, IniPreload or file bytes) for tools that link the code in instead of running the exe. The export and convert entries use it, atlases and preloads can be made in memory (Atlas::MakeImage, MakePreload) and preloads read from and written to streams.
+- --serve [socket]: a server on a local socket that answers requests for single frames of atlases, centered or trimmed, as raw pixels. Atlases are kept in memory with their parsed preloads in an LRU cache (--serve-cache) and read again when their files change.
+- --watch [folder]: after the first run, waits for files in the folder to change and runs again only the entries and pack jobs whose inputs changed. Pack inputs that didn't change are kept trimmed in memory between runs.
+- --plan pack option: lays every pack job out from the TGA headers, bundle indices or --trim-sidecar records without reading pixels or writing anything, and prints the atlas size, fill and time for every combination of --plan-padding, --plan-colour-padding and --plan-power-of-two.
+- --cache [folder]: pack jobs and exports whose inputs and options haven't changed copy their outputs from the cache instead of being made again. --cache-size limits it, the least recently used outputs are dropped.
+- --corpus makes synthetic animations with their atlases and preloads, --run-corpus times pack, export, sprite sheet export and convert over one (wall time, peak RSS, output bytes) and compares the results to a --baseline.
+- --benchmark [pixels/pack/preload/all]: times pixel access and blits, atlas packing and preload reading and writing on generated data.
+- Bytes in pixel buffers are counted by what they hold (sources, atlas, regions, export). The peak of every pack job and of the whole run is printed. --memory-limit stops whatever goes over it with an out of memory error instead of taking the machine down.
+- --max-memory pack option: limits the memory taken by inputs being read at once.
+- --manifest batch mode: every line of the file is a separate command line. Lines run at the same time (--threads limits them), a line that fails doesn't stop the others.
+
 2.0.2.1
 - "Fixed" -pa not taking .ini into account. Though it only works when you drop .ini on the splitter, not .tga. For .tga it tries to find .tga.ini.preload.
 
@@ -93,7 +147,9 @@ enum EntryFlags {
 	ENTRYFLAG_CONVERT_INI,
 	ENTRYFLAG_PACK_INT,
 	ENTRYFLAG_PACK_FLOAT,
-	ENTRYFLAG_PACK_INI
+	ENTRYFLAG_PACK_INI,
+	ENTRYFLAG_REPACK,
+	ENTRYFLAG_MERGE
 };
 
 enum ExportFlags {
@@ -105,32 +161,75 @@ enum ExportFlags {
 struct Entry {
 	int flag;
 	std::string tga, preload;
+	// Pack options of the group and the job the entry belongs to.
+	int job{ 0 };
+	int group{ 0 };
+	int frames{ -1 };
+	int loop{ PackFlags::PACKFLAG_REPEAT_LAST_FRAME };
+};
+
+// Everything the arguments can change. Flags apply to all files that follow.
+struct Options {
+	int default_flag = EntryFlags::ENTRYFLAG_EXPORT;
+	int export_options = ExportFlags::EXPORTFLAG_SPRSHEET_NONE;
+	int pack_loop = PackFlags::PACKFLAG_REPEAT_LAST_FRAME;
+	int pack_frames = -1;
+	int pack_group = 0;
+	int pack_job = 0;
+	std::string pack_output{};
+	int threads = 0;
+	int max_memory = 0; // MB, 0 - no limit
+	int memory_limit = 0; // MB, 0 - no limit
+	int pack_padding = 0;
+	int pack_colour_padding = 2;
+	bool pack_alpha_trimming_only = true;
+	bool pack_power_of_two = true;
+	bool pack_greyscale = false;
+	bool pack_mapped_output = false;
+	int repack_version = 0; // 0 keeps the version of the source preload
+	int merge_version = IniPreload::VERSION_FLOAT;
+	bool search_for_entries = false;
+	bool flip_exported_frames = true;
+	bool export_centered = false;
+	bool export_bundle = false;
+	bool export_global_size = false;
+	std::vector<int> export_frames{};
+	FrameRange export_range{};
+	bool debug_middle = false;
+	bool debug_frame = false;
+	bool debug_show_transparency = false;
+	// bool debug_skip_bad_placement = false;
+	bool keep_window = false; // -k, gKeepWindow once parsed
+	bool profile = false;
+	std::string profile_json{};
+	std::string benchmark{}; // Group to run, empty - none
+	std::string corpus{}; // Folder to generate the corpus in
+	CorpusSettings corpus_settings{};
+	std::string run_corpus{};
+	std::string baseline{};
+	std::string stats_file{};
+	std::string cache{}; // Folder of the output cache, empty - none
+	int cache_size = 0; // MB, 0 - OutputCache::DEFAULT_MAX_BYTES
+	bool cache_hardlinks = false;
+	std::string trim_sidecar{};
+	bool plan = false;
+	PlanSettings plan_settings{};
+	std::string watch{}; // Folder to watch, empty - run once
+	std::string serve{}; // Socket to serve frames on, empty - none
+	int serve_cache = 0; // MB, 0 - FrameServer::DEFAULT_MAX_BYTES
+};
+
+// What one command line (or one line of a --manifest) asks for.
+struct Task {
+	Options options{};
+	std::vector<Entry> entries{};
+	std::vector<PackSettings> pack_jobs{};
+	std::vector<std::string> manifests{};
+	int ok{ 0 }, err{ 0 };
 };
 
 int gCntErr = 0, gCntOk = 0;
-int gDefaultFlag = EntryFlags::ENTRYFLAG_EXPORT;
-int gExportOptions = ExportFlags::EXPORTFLAG_SPRSHEET_NONE;
-int gPackLoop = PackFlags::PACKFLAG_REPEAT_LAST_FRAME;
-int gPackFrames = -1;
-int gPackPadding = 0;
-int gPackColourBleedingPadding = 2;
-bool gPackAlphaTrimmingOnly = true;
-bool gPackPowerOfTwo = true;
-bool gPackGreyscale = false;
-bool gSearchForEntries = false;
-bool gFlipExportedFrames = true;
-bool gExportCentered = false;
 bool gKeepWindow = false;
-bool gDebugSizesMiddle = false;
-bool gDebugSizesFrame = false;
-bool gDebugShowTransparency = false;
-// bool gDebugSkipBadPlacement = false;
-
-// Some of these are duplicated in AtlasPack.cpp and Targa.cpp.
-const PixelData DebugColourMiddleAbs = { 255, 255, 0, 0 }; // Red absolute middle
-const PixelData DebugColourMiddle = { 255, 255, 255, 0 }; // Cyan middle
-const PixelData DebugColourOffset = { 255, 0, 0, 255 }; // Blue offset
-const PixelData DebugColourFrame = { 255, 127, 127, 127 }; // 50% grey frame
 
 void PrintHelp() {
 	printf_s(
@@ -143,7 +242,7 @@ void PrintHelp() {
 
 		"No arguments, just files - equivalent to \"-e -pa\"\n\n"
 
-		"# -pa, --pairs-auto [TGA|PRELOAD...] - App will make an entry if the pair is found [e.g. \"my_file.tga.ini.preload\" looks for \"my_file.tga\", and the opposite way].\n\n" /* gSearchForEntries is responsible for this. */
+		"# -pa, --pairs-auto [TGA|PRELOAD...] - App will make an entry if the pair is found [e.g. \"my_file.tga.ini.preload\" looks for \"my_file.tga\", and the opposite way].\n\n" /* o.search_for_entries is responsible for this. */
 
 		"-p, --pair [TGA, PRELOAD] - Treat the next TWO files as the parts of the next entry (override the search). The order must not be changed.\n\n"
 
@@ -151,6 +250,24 @@ void PrintHelp() {
 
 		"# -k, --keep - Keep the window after execution. ONLY -k WORKS FOR EXE NAME ARGS!!! (currently)\n\n"
 
+		"--threads [number] - Threads to use for sprite sheets, reading pack inputs, pack jobs and manifest lines. 0 (default) - one per core.\n\n"
+		"--max-memory [MB] - Pack: how much memory the inputs being read may take at once. Export: how much the frames waiting to be written may take (64 MB if 0). Reading waits when it's reached, one input is always read. 0 (default) - no limit.\n\n"
+		"--memory-limit [MB] - How much all pixel buffers may take at once. What would go over it fails with a note of what takes the memory, the other entries and jobs go on. For the whole run, so give it on the command line, not in a manifest. 0 (default) - no limit.\n"
+		"--profile - Print the time spent in every stage (open, trim, sizes, pack, blit, save, preload, export, sheet) and counters of the hot paths when done. Export and sheet include the opening and saving done inside them. For the whole run, so give it on the command line, not in a manifest.\n"
+		"--profile-json [file] - Same as --profile, and also save it all to the file as JSON, with the time of every file.\n\n"
+		"--benchmark [group] - Time the hot paths on generated data and print ns/pixel, frames/s and MB/s: pixels (GetPixel, SetPixel, GetRegion, BlitRegionTransparent at 8, 24 and 32 bit), pack (GetSizes, PackAtlas, CreateAtlas on uniform, skewed and long-tail frame sizes), preload (Save and Open of int, float and ini preloads) or all.\n\n"
+		"--cache [folder] - Keep the outputs of pack jobs and exports in the folder, by a hash of the input files, their names and every option that changes the outputs. "
+		"When nothing changed, the outputs are copied from there instead of being made again. Repacks, merges and conversions are not cached.\n"
+		"--cache-size [MB] - How big the cache folder may grow, the least recently used outputs are dropped above it. 0 (default) - 2048 MB.\n"
+		"--cache-hardlinks - Hard link cached outputs instead of copying them. Faster. This tool replaces such a file rather than writing into it, but other programs saving over it in place change the cached copy too. Toggleable, off by default.\n\n"
+		"--corpus [folder] - Generate a synthetic corpus: anim_N/frame_NNNN.tga sequences, each packed into atlas_N_int, atlas_N_float and atlas_N_ini atlases with their preloads. Shaped by:\n"
+		"\t--corpus-canvas [WxH] (256x256), --corpus-sprite [WxH] (96x96), --corpus-frames [number] (24), --corpus-animations [number] (6),\n"
+		"\t--corpus-alpha [solid|soft|noise] (soft), --corpus-duplicates [n] - every n-th frame repeats the one before it (0, none).\n"
+		"--run-corpus [folder] - Run pack, export, sprite sheet export and convert over a corpus, each as a manifest in its own process three times, and save the best wall time, peak RSS and output bytes to results.txt in the folder. Outputs go to out/.\n"
+		"--baseline [file] - Compare --run-corpus results to an older results.txt, which may be the one --run-corpus replaces. Workloads 10%% slower (and 5 ms at least) or bigger, or with other output sizes, count as errors.\n"
+		"--stats-file [file] - Save the peak RSS (KB) and the errors of this run to the file when done. --run-corpus uses it.\n\n"
+		"--manifest [file] - Run every line of the file as a separate command line, several at once. Each line starts with default options and runs single threaded unless it has its own --threads. Empty lines and lines starting with # or ; are skipped. A failed line is reported and doesn't stop the others. Options for the whole run (--watch, --serve, --benchmark, --corpus, --run-corpus, --baseline, --stats-file, --profile, --profile-json, --memory-limit, -k) go on the command line, a line with one of them fails.\n\n"
+
 		"--dbg-middle - Put a RED pixel at the absolute middle, BLUE pixel at the middle + offset.\n"
 		"--dbg-frame - Put GREY frame around the image frame (does not leave the frame border).\n"
 		"Debug options don't work for --sprite-sheet.\n\n"
@@ -169,10 +286,18 @@ void PrintHelp() {
 		"\tUse this if you plan to reimport the frames back using packing options.\n"
 		"\tIt's better not to use this for GIFs due to space wastage.\n\n"
 
+		"--frames-range [a:b[:step]] - Export only frames a to b (both included), every step-th one. \"all\" to export everything again.\n"
+		"--frame-list [a,b,c...] - Export only the listed frames. \"all\" to export everything again.\n"
+		"\tOnly the atlas rows the selected frames take are read. The frame size is calculated from the selected frames only.\n\n"
+
+		"--global-size - Keep the frame size of the whole animation when only some frames are exported. Toggleable, off by default.\n\n"
+
+		"--bundle - Save exported frames into a single .tgab file (frame index + TGAs) instead of a file per frame. The bundle can be given to --pack as is. Toggleable, off by default.\n\n"
+
 		"--dbg-show-transparency - Everything that's considered to be transparent (alpha = 0) is coloured with 25%% opacity pink.\n\n"
 
 		"==== PACKING ====\n"
-		"# --pack [int|float|ini] - All files after this flag will be combined into an atlas + preload pair.\n\n"
+		"# --pack [int|float|ini] - All files after this flag will be combined into an atlas + preload pair. A .tgab bundle adds all of its frames.\n\n"
 
 		"--frames [number] - Put a desired amount of frames instead of automatic detection. 0 for auto.\n\n"
 
@@ -182,6 +307,14 @@ void PrintHelp() {
 		"\tlast - Keep using the last frame given (stop the animation).\n"
 		"\tDefault: last\n\n"
 
+		"--group - Pack files after this flag as the next animation. All groups share one atlas, every group gets its own preload named after its first file. "
+		"--frames and --loop are taken as they are where the group ends (the next --group or the end of the arguments).\n\n"
+
+		"--job - Files after this flag are packed into another atlas. Jobs are independent and packed at the same time. "
+		"Packing options are taken as they are where the job ends (the next --job or the end of the arguments).\n\n"
+
+		"--out [path] - Save the atlas of the current job to this path instead of atl_[first file].\n\n"
+
 		"--padding [number] - Separate frames in the atlas by [number] transparent pixels to avoid colour bleeding. 0 by default (uses --colour-margin instead). If <0, sets to 0.\n\n"
 
 		"--power-of-two [1|0] - If enabled, the resulting atlas has 2^x dimensions. On by default. WARNING! Disabling this will result in a HUGE time increase, it's recommended not to use this option unless it's crucial.\n\n"
@@ -191,6 +324,22 @@ void PrintHelp() {
 		"--colour-padding [number] - Add [number] fully transparent but coloured pixels around each frame to avoid colour bleeding. The default value is 2.\n\n"
 
 		"--greyscale - If the input images sequence is saved as TrueColor 32 bpp images (e.g. how Paint.NET always saves), then the images will be converted to grayscale on the fly USING THE RED CHANNEL. Toggleable, off by default.\n\n"
+		"--trim-sidecar [file] - Pack: remember the trimmed rect of every TGA input in the file. Inputs with the same size and time on later runs aren't scanned again, only their trimmed rows are read. Created if missing. Manifest lines running at once should not share one.\n\n"
+		"--watch [folder] - Keep running: whenever files in the folder (or its subfolders) are saved, run again the exports, conversions, repacks and pack jobs whose files changed. Pack inputs that haven't changed stay trimmed in memory, so only the saved frames are read. Only the files given at the start are watched, new files are not added. Manifests are run once. Stop with Ctrl+C.\n\n"
+		"--serve [socket] - Keep running as a frame server on a local (Unix domain) socket. Tools send lines of tab separated fields: \"frame, index, centered or trimmed, atlas TGA[, preload]\" or \"stats\". "
+		"A frame is answered with \"OK w h bits bytes xo yo\" and a line end followed by the pixels, rows top to bottom, or with \"ERR message\". "
+		"Atlases and their preloads stay in memory between requests and are read again when their files change. Runs after everything else. Stop with Ctrl+C.\n\n"
+		"--serve-cache [MB] - Most memory --serve keeps atlases in before dropping the least recently used. 2048 by default.\n\n"
+		"--plan - Pack: don't pack, print where every frame would go, the atlas size and how much of it the frames fill. Frame sizes are taken from --trim-sidecar records when there are any, otherwise whole images are counted, and bundle frames as big as they were exported. No pixels are read and nothing is saved. Toggleable, off by default.\n\n"
+		"--plan-padding [a,b,...], --plan-colour-padding [a,b,...], --plan-power-of-two [1,0] - With --plan: try every combination of these values instead of only the current settings.\n\n"
+		"--mapped-output - Pack: draw the atlas straight into the output file mapped to memory. Saves a full copy of big atlases. Toggleable, off by default.\n\n"
+
+		"==== REPACKING ====\n"
+		"--repack [int|float|ini|keep] - All pairs after this flag will be packed again with the current packing options and saved as a new atlas + preload pair of the given type (keep - same as the source). "
+		"Frames are cut out of the atlas directly, no files are exported and nothing is trimmed again. Every pair makes its own atlas.\n\n"
+
+		"--merge [int|float|ini] - All pairs after this flag are packed into one shared atlas named after the first pair. "
+		"Every pair gets its own preload of the given type (atl_[its TGA name] + preload extension) pointing into the shared atlas. Nothing is trimmed again.\n\n"
 
 		"Tip: If the executable name has brackets, some arguments can be stated here to be applied automatically.\n"
 		"EXAMPLES (PS.exe is this executable):\n"
@@ -219,7 +368,527 @@ void CallPause() {
 	}
 }
 
-int ParseArgs(std::vector<Entry>& files, int& argc, char**& argv) {
+// Numbers from 0 to INT_MAX split by separator.
+static bool ParseNumbers(const std::string& str, char separator, std::vector<int>& values) {
+	size_t pos = 0;
+	while (pos <= str.size()) {
+		size_t next = str.find(separator, pos);
+		if (next == std::string::npos) { next = str.size(); }
+		std::string part = str.substr(pos, next - pos);
+		char* end = nullptr;
+		errno = 0;
+		long long value = std::strtoll(part.c_str(), &end, 10);
+		if (part.empty() || *end != '\0' || value < 0 || value > INT_MAX || errno == ERANGE) {
+			return false;
+		}
+		values.push_back(static_cast<int>(value));
+		pos = next + 1;
+	}
+	return true;
+}
+
+/* "a,b,c". "all" clears the list. */
+bool ParseFrameList(const std::string& str, std::vector<int>& frames) {
+	frames.clear();
+	return str == "all" || ParseNumbers(str, ',', frames);
+}
+
+/* "a:b[:step]", both inclusive. "all" clears the range. Only the bounds are kept, SelectFrames() cuts them to the preload. */
+bool ParseFrameRange(const std::string& str, FrameRange& range) {
+	range = FrameRange{};
+	if (str == "all") {
+		return true;
+	}
+	std::vector<int> values{};
+	if (!ParseNumbers(str, ':', values) || values.size() < 2 || values.size() > 3 || values[1] < values[0]) {
+		return false;
+	}
+	int step = (values.size() == 3) ? values[2] : 1;
+	if (step <= 0) {
+		return false;
+	}
+	range.first = values[0];
+	range.last = values[1];
+	range.step = step;
+	return true;
+}
+
+// Pack options apply to the whole group, so they are known only when it ends.
+void CloseGroup(Task& task) {
+	const Options& o = task.options;
+	for (Entry& entry : task.entries) {
+		if (entry.group == o.pack_group) {
+			entry.frames = o.pack_frames;
+			entry.loop = o.pack_loop;
+		}
+	}
+}
+
+PackSettings CurrentPackSettings(const Options& o) {
+	PackSettings settings{};
+	settings.padding = o.pack_padding;
+	settings.colour_padding = o.pack_colour_padding;
+	settings.power_of_two = o.pack_power_of_two;
+	settings.greyscale = o.pack_greyscale;
+	settings.debug_show_transparency = o.debug_show_transparency;
+	settings.debug_middle_point = o.debug_middle;
+	settings.debug_show_frame = o.debug_frame;
+	settings.threads = o.threads;
+	settings.mapped_output = o.pack_mapped_output;
+	settings.max_memory = static_cast<size_t>(o.max_memory) << 20;
+	return settings;
+}
+
+// Same as groups, a job takes the packing options it has at its end. --out is only for the job it's given in.
+void CloseJob(Task& task) {
+	Options& o = task.options;
+	PackSettings settings = CurrentPackSettings(o);
+	settings.output = o.pack_output;
+	task.pack_jobs.push_back(settings);
+	o.pack_output.clear();
+}
+
+// The argument list itself, shared by the command line and --manifest lines.
+int ParseOptions(Task& task, int argc, char** argv, int first) {
+	Options& o = task.options;
+	for (int i = first; i < argc; ++i) {
+		if (!strcmp(argv[i], "-p") || !strcmp(argv[i], "--pair")) {
+			if (i + 2 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("-p"));
+				return 0;
+			}
+			Entry entry{ 0 };
+			entry.tga = argv[++i];
+			entry.preload = argv[++i];
+			entry.flag = o.default_flag;
+			entry.job = o.pack_job;
+			entry.group = o.pack_group;
+			task.entries.push_back(entry);
+			continue;
+		}
+		else if (!strcmp(argv[i], "-c") || !strcmp(argv[i], "--convert")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("-c"));
+				return 0;
+			}
+			if (!strcmp(argv[++i], "int"))
+				o.default_flag = ENTRYFLAG_CONVERT_INT;
+			if (!strcmp(argv[i], "float"))
+				o.default_flag = ENTRYFLAG_CONVERT_FLOAT;
+			if (!strcmp(argv[i], "ini"))
+				o.default_flag = ENTRYFLAG_CONVERT_INI;
+			continue;
+		}
+		else if (!strcmp(argv[i], "-e") || !strcmp(argv[i], "--export")) {
+			o.default_flag = ENTRYFLAG_EXPORT;
+			continue;
+		}
+		else if (!strcmp(argv[i], "-pa") || !strcmp(argv[i], "--pairs-auto")) {
+			o.search_for_entries = true;
+			continue;
+		}
+		else if (!strcmp(argv[i], "-ps") || !strcmp(argv[i], "--pairs")) {
+			o.search_for_entries = false;
+			continue;
+		}
+		else if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--flip")) {
+			o.flip_exported_frames = !o.flip_exported_frames;
+			continue;
+		}
+		else if (!strcmp(argv[i], "-k") || !strcmp(argv[i], "--keep")) {
+			o.keep_window = true;
+			continue;
+		}
+		else if (!strcmp(argv[i], "--sprite-sheet")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--sprite-sheet"));
+				return 0;
+			}
+			if (!strcmp(argv[++i], "v"))
+				o.export_options = EXPORTFLAG_SPRSHEET_V;
+			if (!strcmp(argv[i], "h"))
+				o.export_options = EXPORTFLAG_SPRSHEET_H;
+			if (!strcmp(argv[i], "none"))
+				o.export_options = EXPORTFLAG_SPRSHEET_NONE;
+			continue;
+		}
+		else if (!strcmp(argv[i], "--pack")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--pack"));
+				return 0;
+			}
+			if (!strcmp(argv[++i], "int"))
+				o.default_flag = ENTRYFLAG_PACK_INT;
+			if (!strcmp(argv[i], "float"))
+				o.default_flag = ENTRYFLAG_PACK_FLOAT;
+			if (!strcmp(argv[i], "ini"))
+				o.default_flag = ENTRYFLAG_PACK_INI;
+			continue;
+		}
+		else if (!strcmp(argv[i], "--repack")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--repack"));
+				return 0;
+			}
+			o.default_flag = ENTRYFLAG_REPACK;
+			if (!strcmp(argv[++i], "int"))
+				o.repack_version = IniPreload::VERSION_INT;
+			if (!strcmp(argv[i], "float"))
+				o.repack_version = IniPreload::VERSION_FLOAT;
+			if (!strcmp(argv[i], "ini"))
+				o.repack_version = IniPreload::VERSION_INI;
+			if (!strcmp(argv[i], "keep"))
+				o.repack_version = 0;
+			continue;
+		}
+		else if (!strcmp(argv[i], "--merge")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--merge"));
+				return 0;
+			}
+			o.default_flag = ENTRYFLAG_MERGE;
+			if (!strcmp(argv[++i], "int"))
+				o.merge_version = IniPreload::VERSION_INT;
+			if (!strcmp(argv[i], "float"))
+				o.merge_version = IniPreload::VERSION_FLOAT;
+			if (!strcmp(argv[i], "ini"))
+				o.merge_version = IniPreload::VERSION_INI;
+			continue;
+		}
+		else if (!strcmp(argv[i], "--centered")) {
+			o.export_centered = !o.export_centered;
+		}
+		else if (!strcmp(argv[i], "--frames-range") || !strcmp(argv[i], "--frame-list")) {
+			bool range = !strcmp(argv[i], "--frames-range");
+			if (i + 1 >= argc) {
+				printf_s(range ? ERRMSG_NOT_ENOUGH_ARGS("--frames-range") : ERRMSG_NOT_ENOUGH_ARGS("--frame-list"));
+				return 0;
+			}
+			// One replaces the other.
+			o.export_frames.clear();
+			o.export_range = FrameRange{};
+			if (range ? !ParseFrameRange(argv[++i], o.export_range) : !ParseFrameList(argv[++i], o.export_frames)) {
+				printf_s("Bad frame selection \"%s\".\n", argv[i]);
+				return 0;
+			}
+		}
+		else if (!strcmp(argv[i], "--global-size")) {
+			o.export_global_size = !o.export_global_size;
+		}
+		else if (!strcmp(argv[i], "--bundle")) {
+			o.export_bundle = !o.export_bundle;
+		}
+		else if (!strcmp(argv[i], "--loop")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--loop"));
+				return 0;
+			}
+			if (!strcmp(argv[++i], "cycle")) {
+				o.pack_loop = PackFlags::PACKFLAG_REPEAT_LOOP;
+			}
+			if (!strcmp(argv[i], "last")) {
+				o.pack_loop = PackFlags::PACKFLAG_REPEAT_LAST_FRAME;
+			}
+			if (!strcmp(argv[i], "reverse")) {
+				o.pack_loop = PackFlags::PACKFLAG_REPEAT_REVERSE;
+			}
+		}
+		else if (!strcmp(argv[i], "--frames")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--frames"));
+				return 0;
+			}
+			int value = std::strtol(argv[++i], nullptr, 10);
+			o.pack_frames = value;
+		}
+		else if (!strcmp(argv[i], "--group")) {
+			CloseGroup(task);
+			++o.pack_group;
+		}
+		else if (!strcmp(argv[i], "--job")) {
+			CloseGroup(task);
+			CloseJob(task);
+			++o.pack_group;
+			++o.pack_job;
+		}
+		else if (!strcmp(argv[i], "--out")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--out"));
+				return 0;
+			}
+			o.pack_output = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--manifest")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--manifest"));
+				return 0;
+			}
+			task.manifests.push_back(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--threads")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--threads"));
+				return 0;
+			}
+			int value = std::strtol(argv[++i], nullptr, 10);
+			if (value < 0) { value = 0; }
+			o.threads = value;
+		}
+		else if (!strcmp(argv[i], "--max-memory")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--max-memory"));
+				return 0;
+			}
+			int value = std::strtol(argv[++i], nullptr, 10);
+			if (value < 0) { value = 0; }
+			o.max_memory = value;
+		}
+		else if (!strcmp(argv[i], "--benchmark")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--benchmark"));
+				return 0;
+			}
+			o.benchmark = argv[++i];
+			if (!Benchmark::GroupFromName(o.benchmark)) {
+				printf_s("Unknown benchmark group %s.\n", o.benchmark.c_str());
+				return 0;
+			}
+		}
+		else if (!strcmp(argv[i], "--corpus") || !strcmp(argv[i], "--run-corpus") || !strcmp(argv[i], "--baseline") || !strcmp(argv[i], "--stats-file")) {
+			if (i + 1 >= argc) {
+				printf_s("Incorrect %s usage: not enough arguments.\nRun without parameters to see usage examples.\n", argv[i]);
+				return 0;
+			}
+			std::string& value = !strcmp(argv[i], "--corpus") ? o.corpus : !strcmp(argv[i], "--run-corpus") ? o.run_corpus
+				: !strcmp(argv[i], "--baseline") ? o.baseline : o.stats_file;
+			value = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--trim-sidecar")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--trim-sidecar"));
+				return 0;
+			}
+			o.trim_sidecar = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--watch")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--watch"));
+				return 0;
+			}
+			o.watch = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--serve")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--serve"));
+				return 0;
+			}
+			o.serve = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--serve-cache")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--serve-cache"));
+				return 0;
+			}
+			int value = std::strtol(argv[++i], nullptr, 10);
+			if (value < 0) { value = 0; }
+			o.serve_cache = value;
+		}
+		else if (!strcmp(argv[i], "--plan")) {
+			o.plan = !o.plan;
+		}
+		else if (!strcmp(argv[i], "--plan-padding") || !strcmp(argv[i], "--plan-colour-padding") || !strcmp(argv[i], "--plan-power-of-two")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("%s"), argv[i]);
+				return 0;
+			}
+			std::vector<int>& values = !strcmp(argv[i], "--plan-padding") ? o.plan_settings.padding
+				: !strcmp(argv[i], "--plan-colour-padding") ? o.plan_settings.colour_padding : o.plan_settings.power_of_two;
+			if (!ParseFrameList(argv[++i], values)) {
+				printf_s("Bad list \"%s\".\n", argv[i]);
+				return 0;
+			}
+		}
+		else if (!strcmp(argv[i], "--cache")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--cache"));
+				return 0;
+			}
+			o.cache = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--cache-size")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--cache-size"));
+				return 0;
+			}
+			int value = std::strtol(argv[++i], nullptr, 10);
+			if (value < 0) { value = 0; }
+			o.cache_size = value;
+		}
+		else if (!strcmp(argv[i], "--cache-hardlinks")) {
+			o.cache_hardlinks = !o.cache_hardlinks;
+		}
+		else if (!strcmp(argv[i], "--corpus-canvas") || !strcmp(argv[i], "--corpus-sprite")) {
+			if (i + 1 >= argc) {
+				printf_s("Incorrect %s usage: not enough arguments.\nRun without parameters to see usage examples.\n", argv[i]);
+				return 0;
+			}
+			bool canvas = !strcmp(argv[i], "--corpus-canvas");
+			int& w = canvas ? o.corpus_settings.canvas_w : o.corpus_settings.sprite_w;
+			int& h = canvas ? o.corpus_settings.canvas_h : o.corpus_settings.sprite_h;
+			char* end = nullptr;
+			w = std::strtol(argv[++i], &end, 10);
+			h = (*end == 'x') ? std::strtol(end + 1, &end, 10) : 0;
+			if (w <= 0 || h <= 0 || w > 65535 || h > 65535) {
+				printf_s("Incorrect size %s, WxH expected.\n", argv[i]);
+				return 0;
+			}
+		}
+		else if (!strcmp(argv[i], "--corpus-frames") || !strcmp(argv[i], "--corpus-animations") || !strcmp(argv[i], "--corpus-duplicates")) {
+			if (i + 1 >= argc) {
+				printf_s("Incorrect %s usage: not enough arguments.\nRun without parameters to see usage examples.\n", argv[i]);
+				return 0;
+			}
+			int& value = !strcmp(argv[i], "--corpus-frames") ? o.corpus_settings.frames
+				: !strcmp(argv[i], "--corpus-animations") ? o.corpus_settings.animations : o.corpus_settings.duplicates;
+			value = std::strtol(argv[++i], nullptr, 10);
+			if (value < 0) { value = 0; }
+		}
+		else if (!strcmp(argv[i], "--corpus-alpha")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--corpus-alpha"));
+				return 0;
+			}
+			o.corpus_settings.alpha = Corpus::AlphaFromName(argv[++i]);
+			if (o.corpus_settings.alpha < 0) {
+				printf_s("Unknown --corpus-alpha %s.\n", argv[i]);
+				return 0;
+			}
+		}
+		else if (!strcmp(argv[i], "--memory-limit")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--memory-limit"));
+				return 0;
+			}
+			int value = std::strtol(argv[++i], nullptr, 10);
+			if (value < 0) { value = 0; }
+			o.memory_limit = value;
+		}
+		else if (!strcmp(argv[i], "--padding")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--padding"));
+				return 0;
+			}
+			int value = std::strtol(argv[++i], nullptr, 10);
+			if (value < 0) { value = 0; }
+			o.pack_padding = value;
+		}
+		else if (!strcmp(argv[i], "--power-of-two")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--power-of-two"));
+				return 0;
+			}
+			int value = std::strtol(argv[++i], nullptr, 10);
+			o.pack_power_of_two = value;
+		}
+		else if (!strcmp(argv[i], "--use-alpha-trimming")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--use-alpha-trimming"));
+				return 0;
+			}
+			int value = std::strtol(argv[++i], nullptr, 10);
+			o.pack_alpha_trimming_only = value;
+		}
+		else if (!strcmp(argv[i], "--profile")) {
+			o.profile = true;
+		}
+		else if (!strcmp(argv[i], "--profile-json")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--profile-json"));
+				return 0;
+			}
+			o.profile = true;
+			o.profile_json = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--dbg-frame")) {
+			o.debug_frame = true;
+		}
+		else if (!strcmp(argv[i], "--dbg-middle")) {
+			o.debug_middle = true;
+		}
+		else if (!strcmp(argv[i], "--dbg-show-transparency")) {
+			o.debug_show_transparency = true;
+		}
+		//else if (!strcmp(argv[i], "--dbg-skip-bad-placement")) {
+		//	gDebugSkipBadPlacement = true;
+		//}
+		else if (!strcmp(argv[i], "--colour-padding") || !strcmp(argv[i], "--color-padding")) {
+			if (i + 1 >= argc) {
+				printf_s(ERRMSG_NOT_ENOUGH_ARGS("--colour-padding"));
+				return 0;
+			}
+			int value = std::strtol(argv[++i], nullptr, 10);
+			o.pack_colour_padding = value;
+		}
+		else if (!strcmp(argv[i], "--greyscale") || !strcmp(argv[i], "--grayscale")) {
+			o.pack_greyscale = !o.pack_greyscale;
+		}
+		else if (!strcmp(argv[i], "--mapped-output")) {
+			o.pack_mapped_output = !o.pack_mapped_output;
+		}
+
+		else {
+			Entry entry{ 0 };
+			if (o.search_for_entries) {
+				std::string path = argv[i];
+				if (path.rfind('.') != std::string::npos && path.substr(path.rfind('.')) == ".preload" || path.substr(path.rfind('.')) == ".ini") {
+					entry.preload = path;
+					entry.tga = path.substr(0, path.rfind(".ini"));//X.tga.ini.preload
+				}
+				else {
+					entry.tga = path;
+					entry.preload = path + ".ini.preload"; // Well, it can't automatically guess both .ini and .ini.preload with this system...
+				}
+			}
+			else {
+				switch (o.default_flag) {
+				case ENTRYFLAG_EXPORT:
+				case ENTRYFLAG_REPACK:
+				case ENTRYFLAG_MERGE:
+					if (i + 1 >= argc) { 
+						printf_s("An entry without a correct file pair was found. Did you not select the second file or missed an argument parameter?\n");
+						continue; 
+					}
+					entry.tga = argv[i];
+					entry.preload = argv[++i];
+					break;
+				case ENTRYFLAG_CONVERT_INT:
+				case ENTRYFLAG_CONVERT_FLOAT:
+				case ENTRYFLAG_CONVERT_INI:
+					entry.preload = argv[i];
+					break;
+				case ENTRYFLAG_PACK_INT:
+				case ENTRYFLAG_PACK_FLOAT:
+				case ENTRYFLAG_PACK_INI:
+					entry.tga = argv[i];
+					break;
+				default:
+					continue;
+				}
+			}
+			entry.flag = o.default_flag;
+			entry.job = o.pack_job;
+			entry.group = o.pack_group;
+			printf_s("@ %s\n~ %s\n", entry.tga.c_str(), entry.preload.c_str());
+			task.entries.push_back(entry);
+		}
+	}
+	CloseGroup(task);
+	CloseJob(task);
+	return 1;
+}
+
+int ParseArgs(Task& task, int& argc, char**& argv) {
+	Options& o = task.options;
 	if (argc <= 1 || argc >= 2 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))) {
 		gKeepWindow = true;
 		PrintHelp();
@@ -240,681 +909,762 @@ int ParseArgs(std::vector<Entry>& files, int& argc, char**& argv) {
 		/* A bootleg replacement for proper exe name arguments system.
 		Should be reworked later. */
 		if (exe_name_args.find("-e") != std::string::npos) {
-			gDefaultFlag = ENTRYFLAG_EXPORT;
+			o.default_flag = ENTRYFLAG_EXPORT;
 		}
 		if (exe_name_args.find("-c int") != std::string::npos) {
-			gDefaultFlag = ENTRYFLAG_CONVERT_INT;
+			o.default_flag = ENTRYFLAG_CONVERT_INT;
 		}
 		if (exe_name_args.find("-c float") != std::string::npos) {
-			gDefaultFlag = ENTRYFLAG_CONVERT_FLOAT;
+			o.default_flag = ENTRYFLAG_CONVERT_FLOAT;
 		}
 		if (exe_name_args.find("-pa") != std::string::npos)
-			gSearchForEntries = true;
+			o.search_for_entries = true;
 		if (exe_name_args.find("-ps") != std::string::npos)
-			gSearchForEntries = false;
+			o.search_for_entries = false;
 		if (exe_name_args.find("-f") != std::string::npos)
-			gFlipExportedFrames = !gFlipExportedFrames;
+			o.flip_exported_frames = !o.flip_exported_frames;
 		if (exe_name_args.find("-k") != std::string::npos)
 			gKeepWindow = true;
 		if (exe_name_args.find("--sprite-sheet h") != std::string::npos)
-			gExportOptions = EXPORTFLAG_SPRSHEET_H;
+			o.export_options = EXPORTFLAG_SPRSHEET_H;
 		if (exe_name_args.find("--sprite-sheet v") != std::string::npos)
-			gExportOptions = EXPORTFLAG_SPRSHEET_V;
+			o.export_options = EXPORTFLAG_SPRSHEET_V;
 		if (exe_name_args.find("--sprite-sheet none") != std::string::npos)
-			gExportOptions = EXPORTFLAG_SPRSHEET_NONE;
+			o.export_options = EXPORTFLAG_SPRSHEET_NONE;
 		if (exe_name_args.find("--pack int") != std::string::npos) {
-			gDefaultFlag = ENTRYFLAG_PACK_INT;
+			o.default_flag = ENTRYFLAG_PACK_INT;
 		}
 		if (exe_name_args.find("--pack float") != std::string::npos) {
-			gDefaultFlag = ENTRYFLAG_PACK_FLOAT;
+			o.default_flag = ENTRYFLAG_PACK_FLOAT;
 		}
 		if (exe_name_args.find("--centered") != std::string::npos) {
-			gExportCentered = !gExportCentered;
+			o.export_centered = !o.export_centered;
 		}
 		if (exe_name_args.find("--loop cycle")) {
-			gPackLoop = PackFlags::PACKFLAG_REPEAT_LOOP;
+			o.pack_loop = PackFlags::PACKFLAG_REPEAT_LOOP;
 		}
 		if (exe_name_args.find("--loop reverse")) {
-			gPackLoop = PackFlags::PACKFLAG_REPEAT_REVERSE;
+			o.pack_loop = PackFlags::PACKFLAG_REPEAT_REVERSE;
 		}
 		if (exe_name_args.find("--loop last")) {
-			gPackLoop = PackFlags::PACKFLAG_REPEAT_LAST_FRAME;
+			o.pack_loop = PackFlags::PACKFLAG_REPEAT_LAST_FRAME;
 		}
 
-		for (int i = 1; i < argc; ++i) {
-			if (!strcmp(argv[i], "-p") || !strcmp(argv[i], "--pair")) {
-				if (i + 2 >= argc) {
-					printf_s(ERRMSG_NOT_ENOUGH_ARGS("-p"));
-					return 0;
-				}
-				Entry entry{ 0 };
-				entry.tga = argv[++i];
-				entry.preload = argv[++i];
-				entry.flag = gDefaultFlag;
-				files.push_back(entry);
-				continue;
-			}
-			else if (!strcmp(argv[i], "-c") || !strcmp(argv[i], "--convert")) {
-				if (i + 1 >= argc) {
-					printf_s(ERRMSG_NOT_ENOUGH_ARGS("-c"));
-					return 0;
-				}
-				if (!strcmp(argv[++i], "int"))
-					gDefaultFlag = ENTRYFLAG_CONVERT_INT;
-				if (!strcmp(argv[i], "float"))
-					gDefaultFlag = ENTRYFLAG_CONVERT_FLOAT;
-				if (!strcmp(argv[i], "ini"))
-					gDefaultFlag = ENTRYFLAG_CONVERT_INI;
-				continue;
-			}
-			else if (!strcmp(argv[i], "-e") || !strcmp(argv[i], "--export")) {
-				gDefaultFlag = ENTRYFLAG_EXPORT;
-				continue;
-			}
-			else if (!strcmp(argv[i], "-pa") || !strcmp(argv[i], "--pairs-auto")) {
-				gSearchForEntries = true;
-				continue;
-			}
-			else if (!strcmp(argv[i], "-ps") || !strcmp(argv[i], "--pairs")) {
-				gSearchForEntries = false;
-				continue;
-			}
-			else if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--flip")) {
-				gFlipExportedFrames = !gFlipExportedFrames;
-				continue;
-			}
-			else if (!strcmp(argv[i], "-k") || !strcmp(argv[i], "--keep")) {
-				gKeepWindow = true;
-				continue;
-			}
-			else if (!strcmp(argv[i], "--sprite-sheet")) {
-				if (i + 1 >= argc) {
-					printf_s(ERRMSG_NOT_ENOUGH_ARGS("--sprite-sheet"));
-					return 0;
-				}
-				if (!strcmp(argv[++i], "v"))
-					gExportOptions = EXPORTFLAG_SPRSHEET_V;
-				if (!strcmp(argv[i], "h"))
-					gExportOptions = EXPORTFLAG_SPRSHEET_H;
-				if (!strcmp(argv[i], "none"))
-					gExportOptions = EXPORTFLAG_SPRSHEET_NONE;
-				continue;
-			}
-			else if (!strcmp(argv[i], "--pack")) {
-				if (i + 1 >= argc) {
-					printf_s(ERRMSG_NOT_ENOUGH_ARGS("--pack"));
-					return 0;
-				}
-				if (!strcmp(argv[++i], "int"))
-					gDefaultFlag = ENTRYFLAG_PACK_INT;
-				if (!strcmp(argv[i], "float"))
-					gDefaultFlag = ENTRYFLAG_PACK_FLOAT;
-				if (!strcmp(argv[i], "ini"))
-					gDefaultFlag = ENTRYFLAG_PACK_INI;
-				continue;
-			}
-			else if (!strcmp(argv[i], "--centered")) {
-				gExportCentered = !gExportCentered;
-			}
-			else if (!strcmp(argv[i], "--loop")) {
-				if (i + 1 >= argc) {
-					printf_s(ERRMSG_NOT_ENOUGH_ARGS("--loop"));
-					return 0;
+		if (!ParseOptions(task, argc, argv, 1)) {
+			return 0;
+		}
+		if (o.keep_window) {
+			gKeepWindow = true;
+		}
+		return 1;
+	}
+}
+
+// The export options of the library.
+ExportSettings CurrentExportSettings(const Options& o) {
+	ExportSettings settings{};
+	settings.centered = o.export_centered;
+	settings.flip = o.flip_exported_frames;
+	settings.global_size = o.export_global_size;
+	settings.frames = o.export_frames;
+	settings.range = o.export_range;
+	settings.debug_middle = o.debug_middle;
+	settings.debug_frame = o.debug_frame;
+	return settings;
+}
+// frames keeps cropped pack inputs for the next run (--watch), none if null.
+int RunTask(Task& task, FrameCache* frames = nullptr) {
+	Options& o = task.options;
+	std::vector<Entry>& entries = task.entries;
+
+	std::unique_ptr<OutputCache> cache{};
+	if (!o.cache.empty()) {
+		cache = std::make_unique<OutputCache>(o.cache, o.cache_size ? static_cast<size_t>(o.cache_size) << 20 : OutputCache::DEFAULT_MAX_BYTES, o.cache_hardlinks);
+	}
+	TrimSidecar sidecar{};
+	bool use_sidecar = !o.trim_sidecar.empty() && !task.pack_jobs.empty();
+	if (use_sidecar && !sidecar.Open(o.trim_sidecar)) {
+		std::cerr << ERRMSG_FILE(o.trim_sidecar);
+		use_sidecar = false;
+	}
+	std::vector<PackJob> pack_jobs(task.pack_jobs.size());
+	for (size_t j = 0; j < pack_jobs.size(); ++j) {
+		pack_jobs[j].id = static_cast<int>(j);
+		pack_jobs[j].settings = task.pack_jobs[j];
+		pack_jobs[j].cache = cache.get();
+		pack_jobs[j].sidecar = use_sidecar ? &sidecar : nullptr;
+		pack_jobs[j].frames = frames;
+	}
+	std::vector<AtlasEntry> merge_entries{};
+	std::vector<AtlasAnimation> merge_animations{};
+
+	for (size_t i = 0; i < entries.size(); ++i) {
+		try {
+			std::cout <<
+				"\nEntry " << i <<
+				"\nTGA: " << entries[i].tga <<
+				"\nPreload: " << entries[i].preload <<
+				"\nTask: ";
+
+			/* switch here doesn't work because of variables initialisation */
+			if (entries[i].flag == ENTRYFLAG_EXPORT) {
+				ProfileScope profile(PROFSTAGE_EXPORT, &entries[i].tga);
+				PixelScope memory(PIXCAT_EXPORT);
+				printf_s("Export frames.\n");
+				// Outputs are named after the TGA and written next to it.
+				uint64_t cache_key = 0;
+				std::string cache_base = std::filesystem::path(entries[i].tga).parent_path().string();
+				if (cache_base.empty()) {
+					cache_base = ".";
 				}
-				if (!strcmp(argv[++i], "cycle")) {
-					gPackLoop = PackFlags::PACKFLAG_REPEAT_LOOP;
+				if (cache) {
+					CacheKey key{};
+					key.Add(std::filesystem::path(entries[i].tga).filename().generic_string());
+					key.Add(o.export_options);
+					key.Add(o.flip_exported_frames);
+					key.Add(o.export_centered);
+					key.Add(o.export_bundle);
+					key.Add(o.export_global_size);
+					key.Add(static_cast<int>(o.export_frames.size()));
+					for (int frame : o.export_frames) {
+						key.Add(frame);
+					}
+					key.Add(o.export_range.first);
+					key.Add(o.export_range.last);
+					key.Add(o.export_range.step);
+					key.Add(o.debug_middle);
+					key.Add(o.debug_frame);
+					key.Add(o.debug_show_transparency);
+					if (key.AddFile(entries[i].tga) && key.AddFile(entries[i].preload)) {
+						cache_key = key.Get();
+						int restored = cache->Restore(cache_key, cache_base);
+						if (restored) {
+							printf_s("%d files taken from the cache.\n", restored);
+							++task.ok;
+							continue;
+						}
+					}
 				}
-				if (!strcmp(argv[i], "last")) {
-					gPackLoop = PackFlags::PACKFLAG_REPEAT_LAST_FRAME;
+				int err_before = task.err;
+				std::vector<std::string> outputs{};
+				IniPreload preload{};
+				if (!preload.Open(entries[i].preload)) {
+					std::cerr << ERRMSG_FILE(entries[i].preload.c_str());
+					++task.err;
+					continue;
 				}
-				if (!strcmp(argv[i], "reverse")) {
-					gPackLoop = PackFlags::PACKFLAG_REPEAT_REVERSE;
+				preload.PrintFrames();
+				ExportSettings export_settings = CurrentExportSettings(o);
+				std::vector<int> skipped{};
+				std::vector<int> frame_ids = Library::SelectFrames(export_settings, static_cast<int>(preload.frames.size()), &skipped);
+				for (int j : skipped) {
+					printf_s("Frame %d is out of range (%zu frames), skipped.\n", j, preload.frames.size());
 				}
-			}
-			else if (!strcmp(argv[i], "--frames")) {
-				if (i + 1 >= argc) {
-					printf_s(ERRMSG_NOT_ENOUGH_ARGS("--frames"));
-					return 0;
+				if (!export_settings.range.Empty() && static_cast<size_t>(export_settings.range.last) >= preload.frames.size()) {
+					printf_s("Frames %zu to %d of the range are out of range (%zu frames), skipped.\n",
+						std::max(static_cast<size_t>(export_settings.range.first), preload.frames.size()), export_settings.range.last, preload.frames.size());
 				}
-				int value = std::strtol(argv[++i], nullptr, 10);
-				gPackFrames = value;
-			}
-			else if (!strcmp(argv[i], "--padding")) {
-				if (i + 1 >= argc) {
-					printf_s(ERRMSG_NOT_ENOUGH_ARGS("--padding"));
-					return 0;
+				if (frame_ids.empty()) {
+					printf_s("No frames to export.\n");
+					++task.err;
+					continue;
 				}
-				int value = std::strtol(argv[++i], nullptr, 10);
-				if (value < 0) { value = 0; }
-				gPackPadding = value;
-			}
-			else if (!strcmp(argv[i], "--power-of-two")) {
-				if (i + 1 >= argc) {
-					printf_s(ERRMSG_NOT_ENOUGH_ARGS("--power-of-two"));
-					return 0;
+				PreloadFrameData sizes{ 0 };
+				if (o.export_global_size) {
+					std::vector<int> all_ids(preload.frames.size());
+					std::iota(all_ids.begin(), all_ids.end(), 0);
+					sizes = Library::ExportSize(export_settings, preload, all_ids);
 				}
-				int value = std::strtol(argv[++i], nullptr, 10);
-				gPackPowerOfTwo = value;
-			}
-			else if (!strcmp(argv[i], "--use-alpha-trimming")) {
-				if (i + 1 >= argc) {
-					printf_s(ERRMSG_NOT_ENOUGH_ARGS("--use-alpha-trimming"));
-					return 0;
+				else {
+					sizes = Library::ExportSize(export_settings, preload, frame_ids);
 				}
-				int value = std::strtol(argv[++i], nullptr, 10);
-				gPackAlphaTrimmingOnly = value;
-			}
-			else if (!strcmp(argv[i], "--dbg-frame")) {
-				gDebugSizesFrame = true;
-			}
-			else if (!strcmp(argv[i], "--dbg-middle")) {
-				gDebugSizesMiddle = true;
-			}
-			else if (!strcmp(argv[i], "--dbg-show-transparency")) {
-				gDebugShowTransparency = true;
-			}
-			//else if (!strcmp(argv[i], "--dbg-skip-bad-placement")) {
-			//	gDebugSkipBadPlacement = true;
-			//}
-			else if (!strcmp(argv[i], "--colour-padding") || !strcmp(argv[i], "--color-padding")) {
-				if (i + 1 >= argc) {
-					printf_s(ERRMSG_NOT_ENOUGH_ARGS("--colour-padding"));
-					return 0;
+				printf_s("Export dimensions: %dx%d\nAbsolute middle: (%d, %d)\n", sizes.w, sizes.h, sizes.x, sizes.y);
+				Targa tga{};
+				if (!tga.OpenHeader(entries[i].tga)) {
+					std::cerr << ERRMSG_FILE(entries[i].tga.c_str());
+					++task.err;
+					continue;
 				}
-				int value = std::strtol(argv[++i], nullptr, 10);
-				gPackColourBleedingPadding = value;
-			}
-			else if (!strcmp(argv[i], "--greyscale") || !strcmp(argv[i], "--grayscale")) {
-				gPackGreyscale = !gPackGreyscale;
-			}
 
-			else {
-				Entry entry{ 0 };
-				if (gSearchForEntries) {
-					std::string path = argv[i];
-					if (path.rfind('.') != std::string::npos && path.substr(path.rfind('.')) == ".preload" || path.substr(path.rfind('.')) == ".ini") {
-						entry.preload = path;
-						entry.tga = path.substr(0, path.rfind(".ini"));//X.tga.ini.preload
+				// Only read the rows the selected frames take. Frame y is turned into a y inside these rows with window_y.
+				bool src_bottom_to_top = (preload.format_version == preload.VERSION_FLOAT);
+				int atlas_h = tga.h;
+				int row_min = atlas_h, row_max = 0;
+				for (int j : frame_ids) {
+					const PreloadFrameData& fr = preload.frames[j];
+					int from = src_bottom_to_top ? fr.y : atlas_h - fr.y - fr.h;
+					row_min = std::min(row_min, std::max(from, 0));
+					row_max = std::max(row_max, std::min(from + fr.h, atlas_h));
+				}
+				if (row_min >= row_max) {
+					row_min = row_max = 0;
+				}
+				if (!tga.OpenRows(entries[i].tga, row_min, row_max - row_min)) {
+					std::cerr << ERRMSG_FILE(entries[i].tga.c_str());
+					++task.err;
+					continue;
+				}
+				auto window_y = [&](const PreloadFrameData& fr) {
+					return src_bottom_to_top ? fr.y - row_min : fr.y + row_min + tga.h - atlas_h;
+				};
+
+				TargaHeader new_header = tga.GetHeader();
+				new_header.w = (o.export_options == EXPORTFLAG_SPRSHEET_H) ? sizes.w * static_cast<int>(frame_ids.size()) : sizes.w;
+				new_header.h = (o.export_options == EXPORTFLAG_SPRSHEET_V) ? sizes.h * static_cast<int>(frame_ids.size()) : sizes.h;
+				/* 6th bit flips the image vertically. It's not handy for regular TGAs but saves quite a lot of time with animations. */
+				//if (o.flip_exported_frames && o.export_options == EXPORTFLAG_SPRSHEET_NONE) {
+				//	new_header.image_descriptor ^= 0x20;/* This ^ is xor */
+				//}
+				if (o.export_options == EXPORTFLAG_SPRSHEET_NONE) {
+					Bundle bundle{};
+					// Frames are written on other threads while the next ones are cut out.
+					AsyncWriter writer(o.threads, o.max_memory ? static_cast<size_t>(o.max_memory) << 20 : AsyncWriter::DEFAULT_MAX_BYTES);
+					std::string bundle_name = entries[i].tga.substr(0, entries[i].tga.rfind('.')) + Bundle::EXTENSION;
+					if (o.export_bundle) {
+						printf_s("Saving %s\n", bundle_name.c_str());
+						if (!bundle.Create(bundle_name, static_cast<int>(frame_ids.size()))) {
+							std::cerr << ERRMSG_FILE(bundle_name);
+							++task.err;
+							continue;
+						}
 					}
-					else {
-						entry.tga = path;
-						entry.preload = path + ".ini.preload"; // Well, it can't automatically guess both .ini and .ini.preload with this system...
+					for (int j : frame_ids) {
+						Targa tga_out{};
+						tga_out.SetHeader(new_header);
+						char name_part[5] = { 0 };
+						sprintf_s(name_part, "%04d", j);
+						std::string new_name = (
+							entries[i].tga.substr(0, entries[i].tga.rfind('.'))
+							+ '_' + name_part + ".tga");
+						const PreloadFrameData& fr = preload.frames[j];
+						if (!Library::DrawFrame(tga, fr, window_y(fr), src_bottom_to_top, sizes, export_settings, tga_out)) {
+							printf_s("Bad frame %d! main:%d, put %dx%d from %dx%d into %dx%d when the atlas is %dx%d.\n", j, __LINE__,
+								fr.w, fr.h, fr.x, fr.y,
+								tga_out.w, tga_out.h,
+								tga.w, atlas_h
+							);
+							++task.err;
+							continue;
+						}
+						if (o.export_bundle) {
+							writer.Append(bundle, bundle_name, std::move(tga_out), fr);
+							continue;
+						}
+						printf_s("Saving %s\n", new_name.c_str());
+						outputs.push_back(new_name);
+						writer.Save(new_name, std::move(tga_out));
 					}
-				}
-				else {
-					switch (gDefaultFlag) {
-					case ENTRYFLAG_EXPORT:
-						if (i + 1 >= argc) { 
-							printf_s("An entry without a correct file pair was found. Did you not select the second file or missed an argument parameter?\n");
-							continue; 
+					task.err += writer.Finish();
+					if (o.export_bundle) {
+						if (!bundle.Close()) {
+							std::cerr << ERRMSG_FILE(bundle_name);
+							++task.err;
 						}
-						entry.tga = argv[i];
-						entry.preload = argv[++i];
-						break;
-					case ENTRYFLAG_CONVERT_INT:
-					case ENTRYFLAG_CONVERT_FLOAT:
-					case ENTRYFLAG_CONVERT_INI:
-						entry.preload = argv[i];
-						break;
-					case ENTRYFLAG_PACK_INT:
-					case ENTRYFLAG_PACK_FLOAT:
-					case ENTRYFLAG_PACK_INI:
-						entry.tga = argv[i];
-						break;
-					default:
-						continue;
+						outputs.push_back(bundle_name);
 					}
 				}
-				entry.flag = gDefaultFlag;
-				printf_s("@ %s\n~ %s\n", entry.tga.c_str(), entry.preload.c_str());
-				files.push_back(entry);
-			}
-		}
-		return 1;
-	}
-}
-
-PreloadFrameData CalculateTotalFrameSize(IniPreload& preload) {
-	PreloadFrameData sizes{ 0 };
-	int	wLeft = 0,
-		wRight = 0,
-		hTop = 0,
-		hBottom = 0;
-
-	for (size_t i = 0; i < preload.frames.size(); ++i) {
-		// Middle pixel index, starting from 0.
-		// For 33x33 m = 16;				L = m = 16, R = m+1 = 17
-		// For 32x32 m = ceil(15.5) = 16;	L = m = 16, R = m = 16.
-		int w_half = std::ceil(MIDDLE(preload.frames[i].w));
-
-		//if (preload.frames[i].xo >= 0) { // Image shifts right by xo pixels
-		//	wLeft = std::max(wLeft, w_half + 1);
-		//	wRight = std::max(wRight, static_cast<int>(
-		//		w_half + std::round(preload.frames[i].xo)
-		//		));
-		//}
-		//else {
-		//	wLeft = std::max(wLeft, static_cast<int>(
-		//		w_half - std::round(preload.frames[i].xo)
-		//		));
-		//	wRight = std::max(wRight, w_half);
-		//}
-
-		wLeft = std::max(wLeft, static_cast<int>(
-			w_half
-				- ((preload.frames[i].xo < 0) ? std::floor(preload.frames[i].xo + 0.5f) : 0)
-			));
-		wRight = std::max(wRight, static_cast<int>(
-			(w_half + ((preload.frames[i].w % 2 == 1) ? 1 : 0))
-				+ ((preload.frames[i].xo > 0) ? std::floor(preload.frames[i].xo + 0.5f) : 0)
-			));
-
-		int h_half = std::ceil(MIDDLE(preload.frames[i].h));
-		hTop = std::max(hTop, static_cast<int>(
-			h_half
-			- ((preload.frames[i].yo < 0) ? std::floor(preload.frames[i].yo + 0.5f) : 0)
-			));
-		hBottom = std::max(hBottom, static_cast<int>(
-			(h_half + ((preload.frames[i].h % 2 == 1) ? 1 : 0))
-			+ ((preload.frames[i].yo > 0) ? std::floor(preload.frames[i].yo + 0.5f) : 0)
-			));
-
-
-
-		//if (preload.frames[i].yo >= 0) {
-		//	hTop = std::max(hTop, h_half);
-		//	hBottom = std::max(hBottom, static_cast<int>(
-		//		h_half + preload.frames[i].yo
-		//		));
-		//}
-		//else {
-		//	hTop = std::max(hTop, static_cast<int>(
-		//		h_half - preload.frames[i].yo
-		//		));
-		//	hBottom = std::max(hBottom, h_half);
-		//}
-	}
-
-	// Middle point X Y
-	if (gExportCentered) {
-		sizes.x = std::max(wLeft, wRight);
-		sizes.y = std::max(hTop, hBottom);
-		sizes.w = std::max(wLeft, wRight) * 2 + 1; // Making it odd so the middle is in the absolute middle.
-		sizes.h = std::max(hTop, hBottom) * 2 + 1;
-	}
-	else {
-		sizes.x = wLeft;
-		sizes.y = hTop;
-		sizes.w = wLeft + wRight;
-		sizes.h = hTop + hBottom;
-	}
-
-	DEBUG_PRINTVAL(hTop, "%d");
-	DEBUG_PRINTVAL(hBottom, "%d");
-	//DEBUG_PAUSE;
-	return sizes;
-}
-
-
-int main(int argc, char** argv) {
-	std::cout << "Preload splitter v" VERSION_STR " by VerMishelb (" __DATE__ ")\n";
-
-	std::vector<Entry> entries;
-	if (!ParseArgs(entries, argc, argv)) {
-		std::cerr << "An error occurred when parsing arguments.\n";
-		return 1;
-	}
-
-	Atlas atlas;
-	atlas.SetPadding(gPackPadding);
-	atlas.SetColourPadding(gPackColourBleedingPadding);
-	atlas.SetPowerOfTwo(gPackPowerOfTwo);
-	atlas.debug_show_transparency = gDebugShowTransparency;
-	atlas.debug_middle_point = gDebugSizesMiddle;
-	atlas.debug_show_frame = gDebugSizesFrame;
-	std::vector<AtlasEntry> atlas_entries{};
-
-	for (size_t i = 0; i < entries.size(); ++i) {
-		std::cout <<
-			"\nEntry " << i <<
-			"\nTGA: " << entries[i].tga <<
-			"\nPreload: " << entries[i].preload <<
-			"\nTask: ";
-
-		/* switch here doesn't work because of variables initialisation */
-		if (entries[i].flag == ENTRYFLAG_EXPORT) {
-			printf_s("Export frames.\n");
-			IniPreload preload{};
-			if (!preload.Open(entries[i].preload)) {
-				std::cerr << ERRMSG_FILE(entries[i].preload.c_str());
-				++gCntErr;
-				break;
-			}
-			preload.PrintFrames();
-			PreloadFrameData sizes{ 0 };
-			sizes = CalculateTotalFrameSize(preload);
-			printf_s("Export dimensions: %dx%d\nAbsolute middle: (%d, %d)\n", sizes.w, sizes.h, sizes.x, sizes.y);
-			Targa tga{};
-			if (!tga.Open(entries[i].tga)) {
-				std::cerr << ERRMSG_FILE(entries[i].tga.c_str());
-				++gCntErr;
-				break;
-			}
-
-			TargaHeader new_header = tga.GetHeader();
-			new_header.w = (gExportOptions == EXPORTFLAG_SPRSHEET_H) ? sizes.w * preload.frames_amount : sizes.w;
-			new_header.h = (gExportOptions == EXPORTFLAG_SPRSHEET_V) ? sizes.h * preload.frames_amount : sizes.h;
-			/* 6th bit flips the image vertically. It's not handy for regular TGAs but saves quite a lot of time with animations. */
-			//if (gFlipExportedFrames && gExportOptions == EXPORTFLAG_SPRSHEET_NONE) {
-			//	new_header.image_descriptor ^= 0x20;/* This ^ is xor */
-			//}
-			if (gExportOptions == EXPORTFLAG_SPRSHEET_NONE) {
-				for (int j = 0; j < preload.frames_amount; ++j) {
-					Targa tga_out{};
-					tga_out.SetHeader(new_header);
-					char name_part[5] = { 0 };
-					sprintf_s(name_part, "%04d", j);
+				else if (o.export_options == EXPORTFLAG_SPRSHEET_V || o.export_options == EXPORTFLAG_SPRSHEET_H) {
+					char name_part[16] = { 0 };
+					sprintf_s(name_part, "%dx%d", sizes.w, sizes.h);
 					std::string new_name = (
 						entries[i].tga.substr(0, entries[i].tga.rfind('.'))
-						+ '_' + name_part + ".tga");
-					PreloadFrameData fr{ 0 };
-					fr = preload.frames[j];
-
-					// If for w=32 the middle is in x=15.5, then the true middle is 16 and every offset should be extra -0.5.
-					int middle_x = std::ceilf(MIDDLE(fr.w));
-					int middle_y = std::ceilf(MIDDLE(fr.h)); // True for CI4, have to check for other games. Y looks down.
-					// (fr.w % 2 == 0) ? static_cast<int>(std::ceilf(fr.xo - 0.5)) : static_cast<int>(std::ceilf(fr.xo))
-					int ixo = static_cast<int>(std::floor(fr.xo + 0.5));
-					int iyo = static_cast<int>(std::floor(fr.yo + 0.5));
-
-					for (int y = 0; y < fr.h; ++y) {
-						for (int x = 0; x < fr.w; ++x) {
-							//printf_s("putting %dx%d\n", sizes.x - (middle_x) + (int)fr.xo + x, sizes.y - (middle_y) + ((gFlipExportedFrames) ? -(int)fr.yo : (int)fr.yo) + y);
-
-							if (!tga_out.SetPixel(
-									sizes.x - middle_x + ixo + x,
-									sizes.y - middle_y + iyo + y,
-									tga.GetPixel(fr.x + x, fr.y + y, (preload.format_version == preload.VERSION_FLOAT)),
-									!gFlipExportedFrames
-								)
-							) {
-								printf_s("Bad SetPixel! main:%d, put %dx%d when the image is %dx%d.\n", __LINE__,
-									sizes.x - middle_x + ixo + x,
-									sizes.y - middle_y + iyo + y,
-									tga_out.w, tga_out.h
-								);
-								break;
-							}
-						}
+						+ "_sheet" + name_part + ".tga");
+
+					IniPreload selected = preload;
+					selected.frames.clear();
+					for (int j : frame_ids) {
+						PreloadFrameData fr = preload.frames[j];
+						fr.y = window_y(fr);
+						selected.frames.push_back(fr);
 					}
+					selected.frames_amount = static_cast<int>(selected.frames.size());
 
-					//Debug middle and middle with offset
-					if (gDebugSizesMiddle) {
-						//Middle point of the global frame.
-						tga_out.SetPixel(sizes.x, sizes.y, DebugColourMiddleAbs, !gFlipExportedFrames);
-						//Middle point with an offset: the middle of the frame exported.
-						tga_out.SetPixel(sizes.x + ixo, sizes.y + iyo, DebugColourOffset, !gFlipExportedFrames);
-					}
-					if (gDebugSizesFrame) {
-						//Frame top and bottom
-						for (int x = 0; x < fr.w; ++x) {
-							tga_out.SetPixel(
-								sizes.x - (middle_x) + ixo + x,
-								sizes.y - (middle_y) + iyo,
-								(x != middle_x) ? DebugColourFrame : PixelData{DebugColourFrame.a, uint8_t(DebugColourFrame.r * 0.7), uint8_t(DebugColourFrame.g * 0.7), uint8_t(DebugColourFrame.b * 0.7)},
-								!gFlipExportedFrames);
-							tga_out.SetPixel(
-								sizes.x - (middle_x) + ixo + x,
-								sizes.y - (middle_y) + iyo + fr.h - 1,
-								(x != middle_x) ? DebugColourFrame : PixelData{ DebugColourFrame.a, uint8_t(DebugColourFrame.r * 0.7), uint8_t(DebugColourFrame.g * 0.7), uint8_t(DebugColourFrame.b * 0.7) },
-								!gFlipExportedFrames);
-						}
-						//Frame sides
-						for (int y = 0; y < fr.h; ++y) {
-							tga_out.SetPixel(
-								sizes.x - (middle_x) + ixo,
-								sizes.y - (middle_y) + iyo + y,
-								(y != middle_y) ? DebugColourFrame : PixelData{ DebugColourFrame.a, uint8_t(DebugColourFrame.r * 0.7), uint8_t(DebugColourFrame.g * 0.7), uint8_t(DebugColourFrame.b * 0.7) },
-								!gFlipExportedFrames);
-							tga_out.SetPixel(
-								sizes.x - (middle_x) + ixo + fr.w - 1,
-								sizes.y - (middle_y) + iyo + y,
-								(y != middle_y) ? DebugColourFrame : PixelData{ DebugColourFrame.a, uint8_t(DebugColourFrame.r * 0.7), uint8_t(DebugColourFrame.g * 0.7), uint8_t(DebugColourFrame.b * 0.7) },
-								!gFlipExportedFrames);
-						}
-					}
+					SpriteSheet sheet{};
+					sheet.SetThreads(o.threads);
+					sheet.SetVertical(o.export_options == EXPORTFLAG_SPRSHEET_V);
+					sheet.SetFlip(o.flip_exported_frames);
 					printf_s("Saving %s\n", new_name.c_str());
-					if (!tga_out.Save(new_name)) {
+					if (!sheet.Save(new_name, tga, selected, sizes)) {
 						std::cerr << ERRMSG_FILE(new_name);
-						++gCntErr;
-						break;
+						++task.err;
+						continue;
 					}
+					task.err += sheet.bad_frames;
+					outputs.push_back(new_name);
+				}
+				if (cache_key && task.err == err_before) {
+					cache->Store(cache_key, cache_base, outputs);
 				}
+				++task.ok;
 			}
-			else if (gExportOptions == EXPORTFLAG_SPRSHEET_V || gExportOptions == EXPORTFLAG_SPRSHEET_H) {
-				Targa tga_out{};
-				tga_out.SetHeader(new_header);
-				char name_part[16] = { 0 };
-				sprintf_s(name_part, "%dx%d", sizes.w, sizes.h);
-				std::string new_name = (
-					entries[i].tga.substr(0, entries[i].tga.rfind('.'))
-					+ "_sheet" + name_part + ".tga");
-
-				for (int j = 0; j < preload.frames_amount; ++j) {
-					PreloadFrameData fr{ 0 };
-					fr = preload.frames[j];
-
-					int middle_x = std::ceilf(MIDDLE(fr.w));
-					int middle_y = std::ceilf(MIDDLE(fr.h));
-					int ixo = static_cast<int>(std::floor(fr.xo + 0.5f));
-					int iyo = static_cast<int>(std::floor(fr.yo + 0.5f));
-
-					for (int y = 0; y < fr.h; ++y) {
-						for (int x = 0; x < fr.w; ++x) {
-							tga_out.SetPixel(
-								sizes.x - (middle_x) + ixo + x +
-								((gExportOptions == EXPORTFLAG_SPRSHEET_H) ? (j) * sizes.w : 0),
-								sizes.y - (middle_y) + iyo + y +
-								((gExportOptions == EXPORTFLAG_SPRSHEET_V) ? (j) * sizes.h : 0),
-
-								tga.GetPixel(fr.x + x,
-									fr.y + y,
-									(preload.format_version == preload.VERSION_FLOAT)),
-								!gFlipExportedFrames
-							);
-						}
-					}
+
+
+
+			else if (
+				entries[i].flag == ENTRYFLAG_CONVERT_FLOAT || 
+				entries[i].flag == ENTRYFLAG_CONVERT_INT || 
+				entries[i].flag == ENTRYFLAG_CONVERT_INI
+			) {
+				printf_s("Convert to ");
+				if (entries[i].flag == ENTRYFLAG_CONVERT_INT)
+					printf_s("int.\n");
+				else if (entries[i].flag == ENTRYFLAG_CONVERT_FLOAT)
+					printf_s("float.\n");
+				else if (entries[i].flag == ENTRYFLAG_CONVERT_INI)
+					printf_s("float.\n");
+				else { printf_s("Unknown entries[%d].flag == %d\n", i, entries[i].flag); exit(-1); }
+				IniPreload preload{};
+				if (!preload.Open(entries[i].preload)) {
+					std::cerr << ERRMSG_FILE(entries[i].preload);
+					++task.err;
+					continue;
 				}
-				
-				printf_s("Saving %s\n", new_name.c_str());
-				if (!tga_out.Save(new_name)) {
-					std::cerr << ERRMSG_FILE(new_name);
-					++gCntErr;
+
+				int targetVersion = 0;
+
+				switch (entries[i].flag) {
+				case ENTRYFLAG_CONVERT_INT:
+					targetVersion = IniPreload::VERSION_INT;
+					break;
+				case ENTRYFLAG_CONVERT_FLOAT:
+					targetVersion = IniPreload::VERSION_FLOAT;
 					break;
+				case ENTRYFLAG_CONVERT_INI:
+					targetVersion = IniPreload::VERSION_INI;
+					break;
+				}
+
+				if (preload.format_version == targetVersion) {
+					printf_s("This file does not require conversion.\n");
+					++task.ok;
+				}
+				else {
+					Library::ConvertPreload(preload, targetVersion);
+					if (!preload.Save(entries[i].preload)) {
+						std::cerr << "Could not save the file.\n";
+						++task.err;
+					}
+					else {
+						++task.ok;
+					}
 				}
 			}
-			++gCntOk;
-		}
 
 
 
-		else if (
-			entries[i].flag == ENTRYFLAG_CONVERT_FLOAT || 
-			entries[i].flag == ENTRYFLAG_CONVERT_INT || 
-			entries[i].flag == ENTRYFLAG_CONVERT_INI
-		) {
-			printf_s("Convert to ");
-			if (entries[i].flag == ENTRYFLAG_CONVERT_INT)
-				printf_s("int.\n");
-			else if (entries[i].flag == ENTRYFLAG_CONVERT_FLOAT)
-				printf_s("float.\n");
-			else if (entries[i].flag == ENTRYFLAG_CONVERT_INI)
-				printf_s("float.\n");
-			else { printf_s("Unknown entries[%d].flag == %d\n", i, entries[i].flag); exit(-1); }
-			IniPreload preload{};
-			if (!preload.Open(entries[i].preload)) {
-				std::cerr << ERRMSG_FILE(entries[i].preload);
-				++gCntErr;
-				break;
+			else if (
+				entries[i].flag == ENTRYFLAG_PACK_INT || 
+				entries[i].flag == ENTRYFLAG_PACK_FLOAT ||
+				entries[i].flag == ENTRYFLAG_PACK_INI
+			) {
+				printf_s("Pack.\nPreload type: ");
+				if (entries[i].flag == ENTRYFLAG_PACK_INT) {
+					printf_s("int\n");
+				}
+				else if (entries[i].flag == ENTRYFLAG_PACK_FLOAT) {
+					printf_s("float\n");
+				}
+				else if (entries[i].flag == ENTRYFLAG_PACK_INI) {
+					printf_s("ini\n");
+				}
+				else {
+					printf_s("Unknown entries[%d].flag == %d\n", i, entries[i].flag);
+					exit(-1);
+				}
+
+				PackInput input{};
+				input.tga = entries[i].tga;
+				input.group = entries[i].group;
+				input.frames = entries[i].frames;
+				input.loop = entries[i].loop;
+				if (entries[i].flag == ENTRYFLAG_PACK_FLOAT)
+					input.preload_version = IniPreload::VERSION_FLOAT;
+				else if (entries[i].flag == ENTRYFLAG_PACK_INT)
+					input.preload_version = IniPreload::VERSION_INT;
+				else if (entries[i].flag == ENTRYFLAG_PACK_INI)
+					input.preload_version = IniPreload::VERSION_INI;
+				pack_jobs[entries[i].job].inputs.push_back(input);
 			}
+			else if (entries[i].flag == ENTRYFLAG_REPACK) {
+				printf_s("Repack.\n");
+				IniPreload preload{};
+				if (!preload.Open(entries[i].preload)) {
+					std::cerr << ERRMSG_FILE(entries[i].preload);
+					++task.err;
+					continue;
+				}
+				Targa tga{};
+				if (!tga.Open(entries[i].tga)) {
+					std::cerr << ERRMSG_FILE(entries[i].tga);
+					++task.err;
+					continue;
+				}
 
-			int targetVersion = 0;
+				std::vector<AtlasEntry> repack_entries{};
+				if (Atlas::SliceEntries(tga, preload, repack_entries) <= 0) {
+					printf_s("Could not cut the frames out of %s.\n", entries[i].tga.c_str());
+					++task.err;
+					continue;
+				}
+				tga = Targa{};
 
-			switch (entries[i].flag) {
-			case ENTRYFLAG_CONVERT_INT:
-				targetVersion = IniPreload::VERSION_INT;
-				break;
-			case ENTRYFLAG_CONVERT_FLOAT:
-				targetVersion = IniPreload::VERSION_FLOAT;
-				break;
-			case ENTRYFLAG_CONVERT_INI:
-				targetVersion = IniPreload::VERSION_INI;
-				break;
+				int preload_version = o.repack_version;
+				if (!preload_version) {
+					// OpenIni() leaves the version alone and marks the file format instead.
+					preload_version = (preload.file_format == IniPreload::VERSION_INI) ? IniPreload::VERSION_INI : preload.format_version;
+				}
+				Atlas repack_atlas;
+				CurrentPackSettings(o).Apply(repack_atlas);
+				if (repack_atlas.CreateAtlas(repack_entries) == -1) {
+					printf_s("Could not create an image atlas.\n");
+					++task.err;
+				}
+				else if (repack_atlas.SaveAtlas(AtlasPath(entries[i].tga), repack_entries, -1, o.pack_loop, preload_version, o.pack_greyscale) != -1) {
+					++task.ok;
+				}
+				else {
+					++task.err;
+				}
+			}
+			else if (entries[i].flag == ENTRYFLAG_MERGE) {
+				printf_s("Merge.\n");
+				IniPreload preload{};
+				if (!preload.Open(entries[i].preload)) {
+					std::cerr << ERRMSG_FILE(entries[i].preload);
+					++task.err;
+					continue;
+				}
+				Targa tga{};
+				if (!tga.Open(entries[i].tga)) {
+					std::cerr << ERRMSG_FILE(entries[i].tga);
+					++task.err;
+					continue;
+				}
+				AtlasAnimation animation{};
+				animation.tga = entries[i].tga;
+				animation.first = merge_entries.size();
+				if (Atlas::SliceEntries(tga, preload, merge_entries) <= 0) {
+					printf_s("Could not cut the frames out of %s.\n", entries[i].tga.c_str());
+					++task.err;
+					continue;
+				}
+				animation.count = merge_entries.size() - animation.first;
+				merge_animations.push_back(animation);
 			}
+			else {
+				printf_s("Unknown entry %d flag (%d)\n", i, entries[i].flag);
+				++task.err;
+			}
+		}
+		catch (const std::bad_alloc&) {
+			printf_s("Out of memory when working on entry %zu.\n", i);
+			++task.err;
+		}
+	}
 
-			if (preload.format_version == targetVersion) {
-				printf_s("This file does not require conversion.\n");
-				++gCntOk;
+	// Plans are printed one job after another so their tables don't mix.
+	ParallelFor(static_cast<int>(pack_jobs.size()), o.plan ? 1 : o.threads, [&pack_jobs, &o](int j) {
+		if (pack_jobs[j].inputs.empty()) {
+			return;
+		}
+		if (o.plan) {
+			pack_jobs[j].Plan(o.plan_settings);
+		}
+		else {
+			pack_jobs[j].Run();
+		}
+	});
+	for (const PackJob& job : pack_jobs) {
+		if (job.inputs.empty()) {
+			continue;
+		}
+		if (pack_jobs.size() > 1 && !o.plan) {
+			printf_s("Job %d (%zu files): %d saved, %d errors, %zu KB of pixels at most.\n", job.id, job.inputs.size(), job.ok, job.err, job.peak_memory >> 10);
+		}
+		task.ok += job.ok;
+		task.err += job.err;
+	}
+	if (use_sidecar && !sidecar.Save()) {
+		std::cerr << ERRMSG_FILE(o.trim_sidecar);
+		++task.err;
+	}
+
+	if (!merge_entries.empty()) {
+		try {
+			Atlas merge_atlas;
+			CurrentPackSettings(o).Apply(merge_atlas);
+			std::string merge_path = AtlasPath(merge_animations[0].tga);
+			if (merge_atlas.CreateAtlas(merge_entries) == -1) {
+				printf_s("Could not create an image atlas.\n");
+				++task.err;
+			}
+			else if (merge_atlas.SaveImage(merge_path, merge_entries, o.merge_version, o.pack_greyscale) == -1) {
+				std::cerr << ERRMSG_FILE(merge_path);
+				++task.err;
 			}
 			else {
-				preload.SetVersion(targetVersion);
-				if (!preload.Save(entries[i].preload)) {
-					std::cerr << "Could not save the file.\n";
-					++gCntErr;
-				}
-				else {
-					++gCntOk;
+				for (const AtlasAnimation& animation : merge_animations) {
+					std::string preload_path = AtlasPath(animation.tga) + Atlas::PreloadExtension(o.merge_version);
+					printf_s("Saving %s (%zu frames)\n", preload_path.c_str(), animation.count);
+					if (merge_atlas.SavePreload(preload_path, merge_entries, animation.first, animation.count, -1, o.pack_loop, o.merge_version) == -1) {
+						std::cerr << ERRMSG_FILE(preload_path);
+						++task.err;
+					}
+					else {
+						++task.ok;
+					}
 				}
 			}
 		}
+		catch (const std::bad_alloc&) {
+			printf_s("Out of memory when making the merged atlas.\n");
+			++task.err;
+		}
+	}
 
+	return task.err == 0;
+}
 
+// How long the watched folder has to stay quiet before a run, so one save that writes several times is one change.
+static const int WATCH_QUIET_MS = 100;
 
-		else if (
-			entries[i].flag == ENTRYFLAG_PACK_INT || 
-			entries[i].flag == ENTRYFLAG_PACK_FLOAT ||
-			entries[i].flag == ENTRYFLAG_PACK_INI
-		) {
-			printf_s("Pack.\nPreload type: ");
-			if (entries[i].flag == ENTRYFLAG_PACK_INT) {
-				printf_s("int\n");
+static void StampFile(const std::string& path, std::map<std::string, FileStamp>& stamps) {
+	if (!path.empty()) {
+		FileStamp stamp{};
+		FrameCache::Stamp(path, stamp);
+		stamps[path] = stamp;
+	}
+}
+
+/* --watch: runs the task again whenever files in the folder change, but only the entries whose TGA or preload changed,
+whole pack jobs any input of which changed and every --merge pair if one of them did. Unchanged pack inputs are taken from frames.
+The entries are the ones given at the start, new files are not picked up. Runs until stopped or the folder can't be watched. */
+int WatchTask(Task& task, FrameCache& frames) {
+	DirWatcher watcher{};
+	if (!watcher.Open(task.options.watch)) {
+		printf_s("Could not watch %s.\n", task.options.watch.c_str());
+		return 0;
+	}
+	std::map<std::string, FileStamp> stamps{};
+	for (const Entry& entry : task.entries) {
+		StampFile(entry.tga, stamps);
+		StampFile(entry.preload, stamps);
+	}
+	printf_s("\nWatching %s, press Ctrl+C to stop.\n", task.options.watch.c_str());
+	while (watcher.Wait(WATCH_QUIET_MS)) {
+		auto start = std::chrono::steady_clock::now();
+		// Stamped before the run, so a file saved again while it runs makes another run.
+		std::map<std::string, FileStamp> now{};
+		for (const auto& stamp : stamps) {
+			StampFile(stamp.first, now);
+		}
+		auto changed = [&](const std::string& path) { return !path.empty() && now[path] != stamps[path]; };
+		std::vector<bool> jobs(task.pack_jobs.size(), false);
+		bool merge = false;
+		for (const Entry& entry : task.entries) {
+			if (!changed(entry.tga) && !changed(entry.preload)) {
+				continue;
 			}
-			else if (entries[i].flag == ENTRYFLAG_PACK_FLOAT) {
-				printf_s("float\n");
+			if (entry.flag == ENTRYFLAG_PACK_INT || entry.flag == ENTRYFLAG_PACK_FLOAT || entry.flag == ENTRYFLAG_PACK_INI) {
+				jobs[entry.job] = true;
 			}
-			else if (entries[i].flag == ENTRYFLAG_PACK_INI) {
-				printf_s("ini\n");
+			else if (entry.flag == ENTRYFLAG_MERGE) {
+				merge = true;
 			}
-			else {
-				printf_s("Unknown entries[%d].flag == %d\n", i, entries[i].flag);
-				exit(-1);
-			}
-
-			//Open the image
-			AtlasEntry atl_entry{};
-			if (!atl_entry.image.Open(entries[i].tga)) {
-				SCREWUP;
-				return 1;
-			}
-
-			// Calculate frame rect and offset
-			//int left_bound = atl_entry.image.w, // Left empty bound width
-			//	top_bound = atl_entry.image.h; // Top empty bound width
-			Vector2f middle_point_og = { MIDDLE(atl_entry.image.w), MIDDLE(atl_entry.image.h) };
-
-			DEBUG_PRINTVAL(middle_point_og.x, "%.2f");
-			DEBUG_PRINTVAL(middle_point_og.y, "%.2f");
-			int x_useful_min = INT_MAX; // Index of the first pixel from the left that isn't transparent.
-			int x_useful_max = INT_MIN; // Index of the last pixel from the left that isn't transparent.
-			int y_useful_min = INT_MAX; // Index of the first pixel from the top that isn't transparent.
-			int y_useful_max = INT_MIN; // Index of the last pixel from the top that isn't transparent.
-
-			for (int jy = 0; jy < atl_entry.image.h; ++jy) {
-				bool empty_row = true;
-				for (int jx = 0; jx < atl_entry.image.w; ++jx) {
-					// If pixel has something
-					if (!atl_entry.image.PixelIsTransparent(atl_entry.image.GetPixel(jx, jy, false))) {
-						x_useful_min = std::min(x_useful_min, jx);
-						x_useful_max = std::max(x_useful_max, jx);
-						//left_bound = std::min(left_bound, jx); // Is there any case where this is not = x_useful_min?
-						if (empty_row) { empty_row = false; }
-					}
-				}
-				// Line has something
-				if (!empty_row) {
-					y_useful_min = std::min(y_useful_min, jy);
-					y_useful_max = std::max(y_useful_max, jy);
-					//top_bound = std::min(top_bound, jy);
-				}
+		}
+		stamps = now;
+		Task run{};
+		run.options = task.options;
+		run.pack_jobs = task.pack_jobs;
+		for (const Entry& entry : task.entries) {
+			bool pack = entry.flag == ENTRYFLAG_PACK_INT || entry.flag == ENTRYFLAG_PACK_FLOAT || entry.flag == ENTRYFLAG_PACK_INI;
+			if ((pack && jobs[entry.job]) || (entry.flag == ENTRYFLAG_MERGE && merge)
+				|| (!pack && entry.flag != ENTRYFLAG_MERGE && (changed(entry.tga) || changed(entry.preload)))) {
+				run.entries.push_back(entry);
 			}
-			//DEBUG_PRINTVAL(t_bound, "%d");
-			//DEBUG_PRINTVAL(l_bound, "%d");
+		}
+		if (run.entries.empty()) {
+			continue;
+		}
+		RunTask(run, &frames);
+		gCntOk += run.ok;
+		gCntErr += run.err;
+		printf_s("Ran %zu of %zu entries again in %.0f ms: %d saved, %d errors. %zu KB of frames kept.\n",
+			run.entries.size(), task.entries.size(),
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+			run.ok, run.err, frames.Bytes() >> 10);
+	}
+	printf_s("Stopped watching %s.\n", task.options.watch.c_str());
+	return 0;
+}
 
-			// Offsets!
-			if (x_useful_min == INT_MAX) { // The frame is completely transparent. Use the first pixel and make it 1x1.
-				atl_entry.rect.w = 1;
-				atl_entry.rect.h = 1;
-				atl_entry.data_start.x = 0;
-				atl_entry.data_start.y = 0;
-				atl_entry.offset.x = 0.f;
-				atl_entry.offset.y = 0.f;
+// Splits a manifest line into arguments. "Quoted parts" may contain spaces.
+bool SplitArgs(const std::string& line, std::vector<std::string>& args) {
+	args.clear();
+	std::string arg{};
+	bool quoted = false, has_arg = false;
+	for (char c : line) {
+		if (c == '"') {
+			quoted = !quoted;
+			has_arg = true;
+		}
+		else if (!quoted && (c == ' ' || c == '\t' || c == '\r')) {
+			if (has_arg) {
+				args.push_back(arg);
+				arg.clear();
+				has_arg = false;
 			}
-			else {
-				atl_entry.rect.w = (x_useful_max - x_useful_min) + 1;
-				atl_entry.rect.h = (y_useful_max - y_useful_min) + 1;
-				atl_entry.data_start.x = x_useful_min;
-				atl_entry.data_start.y = y_useful_min;
-				atl_entry.offset.x = x_useful_min + MIDDLE(atl_entry.rect.w) - middle_point_og.x;
-				atl_entry.offset.y = y_useful_min + MIDDLE(atl_entry.rect.h) - middle_point_og.y;
-			}
-
-			printf_s("Atlas entry\nWxH: %dx%d\nOffsets (rounded): %.2f (%d), %.2f (%d)\nColour margin: %d\nMargin: %d\n",
-				atl_entry.rect.w,
-				atl_entry.rect.h,
-				atl_entry.offset.x, static_cast<int>(std::floor(atl_entry.offset.x + 0.5f)),
-				atl_entry.offset.y, static_cast<int>(std::floor(atl_entry.offset.y + 0.5f)),
-				gPackColourBleedingPadding,
-				gPackPadding
-				);
-			DEBUG_PRINTVAL(atl_entry.data_start.x, "%d");
-			DEBUG_PRINTVAL(atl_entry.data_start.y, "%d")
-			//DEBUG_PAUSE_EXIT;
-
-			atlas_entries.push_back(atl_entry);
 		}
 		else {
-			printf_s("Unknown entry %d flag (%d)\n", i, entries[i].flag);
-			++gCntErr;
+			arg += c;
+			has_arg = true;
 		}
 	}
+	if (has_arg) {
+		args.push_back(arg);
+	}
+	return !quoted;
+}
 
-	if (!atlas_entries.empty()) {
-		if (atlas.CreateAtlas(atlas_entries) == -1) {
-			printf_s("Could not create an image atlas.\n");
-			++gCntErr;
+/* Each line is a command line of its own, starting with default options. Empty lines and lines
+starting with # or ; are skipped. Returns the amount of lines that failed. */
+int RunManifest(const std::string& path, int threads) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		std::cerr << ERRMSG_FILE(path);
+		return -1;
+	}
+	std::vector<std::string> lines{};
+	std::vector<int> line_numbers{};
+	std::string line{};
+	for (int n = 1; std::getline(file, line); ++n) {
+		size_t start = line.find_first_not_of(" \t\r");
+		if (start == std::string::npos || line[start] == '#' || line[start] == ';') {
+			continue;
 		}
-		else {
-			int preload_version = 0;
-			if (entries[0].flag == ENTRYFLAG_PACK_FLOAT)
-				preload_version = IniPreload::VERSION_FLOAT;
-			else if (entries[0].flag == ENTRYFLAG_PACK_INT)
-				preload_version = IniPreload::VERSION_INT;
-			else if (entries[0].flag == ENTRYFLAG_PACK_INI) {
-				preload_version = IniPreload::VERSION_INI;
-			}
-			char new_path[_MAX_PATH] = { 0 };
-			sprintf_s(
-				new_path, "%satl_%s",
-				entries[0].tga.substr(0, entries[0].tga.find_last_of("\\/") + 1).c_str(),
-				entries[0].tga.substr(entries[0].tga.find_last_of("\\/") + 1).c_str()
-			);
-			if (atlas.SaveAtlas(new_path, atlas_entries, gPackFrames, gPackLoop, preload_version, gPackGreyscale) != -1) {
-				++gCntOk;
-			}
-			else {
+		lines.push_back(line);
+		line_numbers.push_back(n);
+	}
+	file.close();
+	printf_s("Manifest %s: %zu lines.\n", path.c_str(), lines.size());
+
+	std::vector<Task> tasks(lines.size());
+	std::vector<int> results(lines.size(), 0);
+	ParallelFor(static_cast<int>(lines.size()), threads, [&](int j) {
+		Task& task = tasks[j];
+		// The lines already run in parallel, so each one is single threaded unless it asks otherwise.
+		task.options.threads = 1;
+		std::vector<std::string> args{};
+		if (!SplitArgs(lines[j], args)) {
+			printf_s("%s:%d: unclosed quote.\n", path.c_str(), line_numbers[j]);
+			return;
+		}
+		std::vector<char*> argv{};
+		for (std::string& arg : args) {
+			argv.push_back(arg.data());
+		}
+		if (!ParseOptions(task, static_cast<int>(argv.size()), argv.data(), 0)) {
+			printf_s("%s:%d: could not parse the arguments.\n", path.c_str(), line_numbers[j]);
+			return;
+		}
+		if (!task.manifests.empty()) {
+			printf_s("%s:%d: --manifest can't be used inside a manifest.\n", path.c_str(), line_numbers[j]);
+			return;
+		}
+		// These run once for the whole command line, a manifest line would silently skip them.
+		const Options& o = task.options;
+		const char* whole_run = !o.watch.empty() ? "--watch" : !o.serve.empty() ? "--serve" : !o.benchmark.empty() ? "--benchmark"
+			: !o.corpus.empty() ? "--corpus" : !o.run_corpus.empty() ? "--run-corpus" : !o.baseline.empty() ? "--baseline"
+			: !o.stats_file.empty() ? "--stats-file" : !o.profile_json.empty() ? "--profile-json" : o.profile ? "--profile"
+			: o.memory_limit ? "--memory-limit" : o.keep_window ? "-k" : nullptr;
+		if (whole_run) {
+			printf_s("%s:%d: %s can't be used inside a manifest.\n", path.c_str(), line_numbers[j], whole_run);
+			return;
+		}
+		results[j] = RunTask(task);
+	});
+
+	int failed = 0;
+	for (size_t j = 0; j < tasks.size(); ++j) {
+		gCntOk += tasks[j].ok;
+		gCntErr += tasks[j].err;
+		if (!results[j]) {
+			printf_s("%s:%d failed (%d saved, %d errors).\n", path.c_str(), line_numbers[j], tasks[j].ok, tasks[j].err);
+			++failed;
+			if (tasks[j].err == 0) {
 				++gCntErr;
 			}
+		}
+	}
+	return failed;
+}
 
+int main(int argc, char** argv) {
+	std::cout << "Preload splitter v" VERSION_STR " by VerMishelb (" __DATE__ ")\n";
+	// --run-corpus starts this exe again, so keep where it is before the arguments are touched.
+	std::string exe = argv[0];
+	if (exe.find_first_of("\\/") != std::string::npos) {
+		std::error_code error{};
+		std::filesystem::path absolute = std::filesystem::absolute(exe, error);
+		if (!error) {
+			exe = absolute.string();
+		}
+	}
+
+	Task task{};
+	if (!ParseArgs(task, argc, argv)) {
+		std::cerr << "An error occurred when parsing arguments.\n";
+		return 1;
+	}
+
+	Profile::Enable(task.options.profile);
+	PixelPool::SetLimit(static_cast<size_t>(task.options.memory_limit) << 20);
+	if (!task.options.benchmark.empty()) {
+		if (Benchmark::Run(task.options.benchmark)) {
+			++gCntOk;
+		}
+		else {
+			++gCntErr;
+		}
+	}
+	if (!task.options.corpus.empty()) {
+		if (Corpus::Generate(task.options.corpus, task.options.corpus_settings)) {
+			++gCntOk;
+		}
+		else {
+			++gCntErr;
+		}
+	}
+	if (!task.options.run_corpus.empty()) {
+		if (Corpus::Run(exe, task.options.run_corpus, task.options.baseline, task.options.threads)) {
+			++gCntOk;
+		}
+		else {
+			++gCntErr;
+		}
+	}
+	FrameCache frames{};
+	RunTask(task, task.options.watch.empty() ? nullptr : &frames);
+	gCntOk += task.ok;
+	gCntErr += task.err;
+
+	for (const std::string& manifest : task.manifests) {
+		int failed = RunManifest(manifest, task.options.threads);
+		if (failed < 0) {
+			++gCntErr;
+		}
+		else if (failed > 0) {
+			printf_s("Manifest %s: %d lines failed.\n", manifest.c_str(), failed);
+		}
+	}
+	if (!task.options.watch.empty() && !WatchTask(task, frames)) {
+		++gCntErr;
+	}
+	if (!task.options.serve.empty()) {
+		FrameServer server(task.options.serve_cache ? static_cast<size_t>(task.options.serve_cache) << 20 : FrameServer::DEFAULT_MAX_BYTES);
+		if (!server.Run(task.options.serve)) {
+			printf_s("Could not serve on %s.\n", task.options.serve.c_str());
+			++gCntErr;
 		}
 	}
 
@@ -922,8 +1672,22 @@ int main(int argc, char** argv) {
 		"Done working.\n\tSuccess: %d\n\tErrors: %d\n\tTotal: %d\nPlease feed Slob God or it will starve.\n",
 		gCntOk, gCntErr, gCntErr + gCntOk
 	);
+	PixelPool::Stats memory = PixelPool::GetStats();
+	printf_s("Pixel memory peak: %zu KB (", memory.peak_bytes >> 10);
+	for (int i = 0; i < PIXCATS_AMOUNT; ++i) {
+		printf_s("%s %zu KB%s", PixelPool::CategoryName(i), memory.category_peak[i] >> 10, (i + 1 < PIXCATS_AMOUNT) ? ", " : ").\n");
+	}
+	if (!task.options.stats_file.empty() && !Corpus::SaveStats(task.options.stats_file, gCntErr)) {
+		std::cerr << ERRMSG_FILE(task.options.stats_file);
+	}
+	if (Profile::Enabled()) {
+		Profile::PrintSummary();
+		if (!task.options.profile_json.empty() && !Profile::SaveJson(task.options.profile_json)) {
+			std::cerr << ERRMSG_FILE(task.options.profile_json);
+		}
+	}
 
 	CallPause();
 
 	return 0;
-}
\ No newline at end of file
+}